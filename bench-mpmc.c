@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * Inbox queue benchmark
+ *
+ * N producers push and N consumers pop a fixed number of processes
+ * through one queue of the run queue inbox size, first the lock-free
+ * MPMC queue, then a ring array behind a mutex. Prints pushes and pops
+ * per second for each N. A producer finding the queue full, or a
+ * consumer finding it empty, yields and retries.
+ *
+ * Build: gcc -O2 -pthread -iquote include -o bench-mpmc bench-mpmc.c mpmc-queue.c
+ * Usage: bench-mpmc [ops per producer] [max N]
+ */
+
+#include "common.h"
+#include "queue.h"
+#include <pthread.h>
+#include <sched.h>		/* sched_yield, not include/sched.h */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_QSIZE	256	/* RQ_INBOX_SIZE */
+
+struct lock_queue {
+	pthread_mutex_t lock;
+	struct pcb_t * slot[BENCH_QSIZE];
+	unsigned long head, tail;
+};
+
+static int lock_push(struct lock_queue * q, struct pcb_t * proc) {
+	int ret = -1;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->tail - q->head < BENCH_QSIZE) {
+		q->slot[q->tail++ % BENCH_QSIZE] = proc;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&q->lock);
+	return ret;
+}
+
+static struct pcb_t * lock_pop(struct lock_queue * q) {
+	struct pcb_t * proc = NULL;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->head != q->tail)
+		proc = q->slot[q->head++ % BENCH_QSIZE];
+	pthread_mutex_unlock(&q->lock);
+	return proc;
+}
+
+static struct mpmc_queue * mq;
+static struct lock_queue lq;
+static int use_lock;
+static unsigned long ops;		/* pushes per producer */
+static unsigned long left;		/* pops still to do (atomic) */
+
+static void * producer(void * arg) {
+	unsigned long i;
+
+	for (i = 1; i <= ops; i++) {
+		/* Any non-NULL pointer, nothing dereferences it */
+		struct pcb_t * proc = (struct pcb_t *)(uintptr_t)i;
+
+		while ((use_lock ? lock_push(&lq, proc) : mpmc_push(mq, proc)) != 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+static void * consumer(void * arg) {
+	while (__atomic_load_n(&left, __ATOMIC_RELAXED) > 0) {
+		if ((use_lock ? lock_pop(&lq) : mpmc_pop(mq)) == NULL)
+			sched_yield();
+		else
+			__atomic_sub_fetch(&left, 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Pushes plus pops per second through N producers and N consumers */
+static double run(int n) {
+	pthread_t * th = malloc(2 * n * sizeof(pthread_t));
+	double t;
+	int i;
+
+	if (th == NULL)
+		return 0;
+
+	left = ops * n;
+	lq.head = lq.tail = 0;
+
+	t = now();
+	for (i = 0; i < n; i++) {
+		pthread_create(&th[i], NULL, producer, NULL);
+		pthread_create(&th[n + i], NULL, consumer, NULL);
+	}
+	for (i = 0; i < 2 * n; i++)
+		pthread_join(th[i], NULL);
+	t = now() - t;
+
+	free(th);
+	return 2.0 * ops * n / t;
+}
+
+int main(int argc, char * argv[]) {
+	int maxn = argc > 2 ? atoi(argv[2]) : 16;
+	int n;
+
+	ops = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+
+	mq = mpmc_create(BENCH_QSIZE);
+	if (mq == NULL || ops == 0 || maxn <= 0) {
+		fprintf(stderr, "Usage: %s [ops per producer] [max N]\n", argv[0]);
+		return 1;
+	}
+	pthread_mutex_init(&lq.lock, NULL);
+
+	printf("%8s %16s %16s\n", "N", "mpmc ops/s", "mutex ops/s");
+	for (n = 1; n <= maxn; n *= 2) {
+		double m, l;
+
+		use_lock = 0;
+		m = run(n);
+		use_lock = 1;
+		l = run(n);
+		printf("%8d %16.0f %16.0f\n", n, m, l);
+	}
+
+	pthread_mutex_destroy(&lq.lock);
+	mpmc_destroy(mq);
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * Slot clock benchmark
+ *
+ * Attaches N events, one thread each, runs K slots in which every event
+ * only calls slot_next(), and prints slots per second for N = 1, 2, 4
+ * ... 512. Nothing but the slot boundary is measured. The clock prints
+ * every slot on stdout, the results go to stderr.
+ *
+ * Build: gcc -O2 -pthread -iquote include -o bench-slot bench-slot.c timer-slot.c
+ * Usage: bench-slot [slots] [max N] > /dev/null
+ */
+
+#include "timer.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static unsigned long nr_slots;
+
+static void * event_routine(void * arg) {
+	struct slot_event * ev = (struct slot_event *)arg;
+	unsigned long i;
+
+	for (i = 0; i < nr_slots; i++)
+		slot_next(ev);
+	slot_detach(ev);
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Slots per second with n events */
+static double run(int n) {
+	struct slot_event ** ev = malloc(n * sizeof(struct slot_event *));
+	pthread_t * th = malloc(n * sizeof(pthread_t));
+	double t = 0;
+	int i;
+
+	if (ev == NULL || th == NULL)
+		goto out;
+
+	for (i = 0; i < n; i++)
+		ev[i] = slot_attach();
+	slot_start();
+
+	t = now();
+	for (i = 0; i < n; i++)
+		pthread_create(&th[i], NULL, event_routine, ev[i]);
+	for (i = 0; i < n; i++)
+		pthread_join(th[i], NULL);
+	t = now() - t;
+
+	slot_stop();
+out:
+	free(ev);
+	free(th);
+	return t > 0 ? nr_slots / t : 0;
+}
+
+int main(int argc, char * argv[]) {
+	int maxn = argc > 2 ? atoi(argv[2]) : 512;
+	int n;
+
+	nr_slots = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	if (nr_slots == 0 || maxn <= 0) {
+		fprintf(stderr, "Usage: %s [slots] [max N]\n", argv[0]);
+		return 1;
+	}
+
+	fprintf(stderr, "%8s %16s\n", "N", "slots/s");
+	for (n = 1; n <= maxn; n *= 2)
+		fprintf(stderr, "%8d %16.0f\n", n, run(n));
+
+	return 0;
+}
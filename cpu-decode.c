@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * Pre-decoded instructions
+ *
+ * The loader decodes a code segment once: every instruction becomes its
+ * handler, resolved for the memory model the simulator is built with,
+ * next to its operands. run_decoded() then executes an instruction with
+ * a single indirect call, no opcode switch and no per-build dispatch.
+ * A segment that could not be decoded still runs through run().
+ */
+
+#include "common.h"
+#include "cpu.h"
+#include "mm.h"
+#include "libmem.h"
+#include "syscall.h"
+#include <stdlib.h>
+
+struct decoded_inst {
+	int (*op)(struct pcb_t * proc, const struct decoded_inst * ins);
+	uint32_t arg_0;
+	uint32_t arg_1;
+	uint32_t arg_2;
+	uint32_t arg_3;
+};
+
+#ifdef MM_PAGING
+static int op_calc(struct pcb_t * proc, const struct decoded_inst * ins) {
+	return 0;
+}
+
+static int op_alloc(struct pcb_t * proc, const struct decoded_inst * ins) {
+#ifdef CPU_TLB
+	return tlballoc(proc, ins->arg_0, ins->arg_1);
+#else
+	return liballoc(proc, ins->arg_0, ins->arg_1);
+#endif
+}
+
+static int op_free(struct pcb_t * proc, const struct decoded_inst * ins) {
+#ifdef CPU_TLB
+	return tlbfree_data(proc, ins->arg_0);
+#else
+	return libfree(proc, ins->arg_0);
+#endif
+}
+
+static int op_read(struct pcb_t * proc, const struct decoded_inst * ins) {
+#ifdef CPU_TLB
+	return tlbread(proc, ins->arg_0, ins->arg_1, ins->arg_2);
+#else
+	uint32_t data;
+
+	/* As in run(), the value read is not kept */
+	return libread(proc, ins->arg_0, ins->arg_1, &data);
+#endif
+}
+
+static int op_write(struct pcb_t * proc, const struct decoded_inst * ins) {
+#ifdef CPU_TLB
+	return tlbwrite(proc, ins->arg_0, ins->arg_1, ins->arg_2);
+#else
+	return libwrite(proc, ins->arg_0, ins->arg_1, ins->arg_2);
+#endif
+}
+
+static int op_syscall(struct pcb_t * proc, const struct decoded_inst * ins) {
+	return libsyscall(proc, ins->arg_0, ins->arg_1, ins->arg_2, ins->arg_3);
+}
+
+static int op_invalid(struct pcb_t * proc, const struct decoded_inst * ins) {
+	return 1;
+}
+#endif
+
+/*
+ * cpu_decode - decode a code segment for run_decoded()
+ * Return -1 when the segment is left to run().
+ */
+int cpu_decode(struct code_seg_t * code) {
+#ifdef MM_PAGING
+	struct decoded_inst * dtext;
+	uint32_t i;
+
+	code->dtext = NULL;
+	if (code->size == 0)
+		return -1;
+
+	dtext = malloc(code->size * sizeof(struct decoded_inst));
+	if (dtext == NULL)
+		return -1;
+
+	for (i = 0; i < code->size; i++) {
+		const struct inst_t * ins = &code->text[i];
+
+		switch (ins->opcode) {
+		case CALC:
+			dtext[i].op = op_calc;
+			break;
+		case ALLOC:
+			dtext[i].op = op_alloc;
+			break;
+		case FREE:
+			dtext[i].op = op_free;
+			break;
+		case READ:
+			dtext[i].op = op_read;
+			break;
+		case WRITE:
+			dtext[i].op = op_write;
+			break;
+		case SYSCALL:
+			dtext[i].op = op_syscall;
+			break;
+		default:
+			dtext[i].op = op_invalid;
+		}
+		dtext[i].arg_0 = ins->arg_0;
+		dtext[i].arg_1 = ins->arg_1;
+		dtext[i].arg_2 = ins->arg_2;
+		dtext[i].arg_3 = ins->arg_3;
+	}
+
+	code->dtext = dtext;
+	return 0;
+#else
+	/* Handlers of the legacy memory model are private to cpu.c */
+	code->dtext = NULL;
+	return -1;
+#endif
+}
+
+void cpu_decode_free(struct code_seg_t * code) {
+	free(code->dtext);
+	code->dtext = NULL;
+}
+
+/* Same as run(), on the decoded segment when there is one */
+int run_decoded(struct pcb_t * proc) {
+	const struct decoded_inst * ins;
+
+	if (proc->code->dtext == NULL)
+		return run(proc);
+	if (proc->pc >= proc->code->size)
+		return 1;
+
+	ins = &proc->code->dtext[proc->pc++];
+	return ins->op(proc, ins);
+}
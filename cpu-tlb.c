@@ -1,419 +1,604 @@
-/*
- * Copyright (C) 2024 pdnguyen of the HCMC University of Technology
- */
-/*
- * Source Code License Grant: Authors hereby grants to Licensee
- * a personal to use and modify the Licensed Source Code for
- * the sole purpose of studying during attending the course CO2018.
- */
-// #ifdef CPU_TLB
-/*
- * CPU TLB
- * TLB module cpu/cpu-tlb.c
- */
-
- #include "mm.h"
- #include <stdlib.h>
- #include <stdio.h>
- 
- /*
-   This function is unnecessary
- */
- int
- tlb_change_all_page_tables_of (struct pcb_t *proc, struct memphy_struct *mp)
- {
-   /* TODO: update all page table directory info
-    *      in flush or wipe TLB (if needed)
-    */
-   tlb_flush_tlb_of(proc, mp);
- 
-   return 0;
- }
- 
- int
- tlb_flush_tlb_of (struct pcb_t *proc, struct memphy_struct *mp)
- {
-   /* TODO: flush tlb cached*/
-   // each process has its tlb_entry directly mapped to a specific address
-   for (int i = 0; i * 8 + (proc->pid - 1) < mp->maxsz; i++)
-     {
-       // this loops through every entries supposed to be
-       // belonged to that process and set the entry to 0
-       tlb_cache_write (mp, proc->pid, i, 0);
-     }
- 
-   return 0;
- }
- 
- /*tlballoc - CPU TLB-based allocate a region memory
-  *@proc:  Process executing the instruction
-  *@size: allocated size
-  *@reg_index: memory region ID (used to identify variable in symbole table)
-  */
- int
- tlballoc (struct pcb_t *proc, uint32_t size, uint32_t reg_index)
- {
-   int* addr = (int*)malloc(sizeof(int));
-   int val;
- 
-   /* By default using vmaid = 0 */
-   val = __alloc (proc, 0, reg_index, size, addr);
- 
-   /* TODO: update TLB CACHED frame num of the new allocated page(s)*/
-   /* by using tlb_cache_read()/tlb_cache_write()*/
- 
-   int pgn = PAGING_PGN (*addr);
-   int* frmnum = (int*)malloc(sizeof(int));
-   if (pg_getpage (proc->mm, pgn, frmnum, proc) != 0)
-     return -1; /* invalid page access */
-   tlb_cache_write (proc->tlb, proc->pid, pgn, *frmnum);
- 
-   return val;
- }
- 
- /*pgfree - CPU TLB-based free a region memory
-  *@proc: Process executing the instruction
-  *@size: allocated size
-  *@reg_index: memory region ID (used to identify variable in symbole table)
-  */
- int
- tlbfree_data (struct pcb_t *proc, uint32_t reg_index)
- {
-   __free (proc, 0, reg_index);
- 
-   /* TODO: update TLB CACHED frame num of freed page(s)*/
-   /* by using tlb_cache_read()/tlb_cache_write()*/
-   tlb_flush_tlb_of (proc, proc->tlb);
- 
-   return 0;
- }
- 
- /*tlbread - CPU TLB-based read a region memory
-  *@proc: Process executing the instruction
-  *@source: index of source register
-  *@offset: source address = [source] + [offset]
-  *@destination: destination storage
-  */
- int
- tlbread (struct pcb_t *proc, uint32_t source, uint32_t offset,
-          uint32_t destination)
- {
-   BYTE *data = (BYTE *)malloc(sizeof (BYTE));
-   int frmnum = -1;
- 
-   /* TODO: retrieve TLB CACHED frame num of accessing page(s)*/
-   /* by using tlb_cache_read()/tlb_cache_write()*/
-   /* frmnum is return value of tlb_cache_read/write value*/
- 
-   // retrieve pgnum from address
-   struct vm_rg_struct *currg = get_symrg_byid (proc->mm, source);
-   if(!currg){
-     printf("Invalid address: region not found at region=%d offset=%d. READ operation aborted.\n", source, offset);
-     return -1;
-   }
-   if (currg->rg_start + offset >= currg->rg_end) {
-     // ! Invalid access address (out of bound)
-     printf("Invalid address: out of bound at region=%d offset=%d. READ operation aborted.\n", source, offset);
-     return -1;
-   }
-   int addr = currg->rg_start + offset; // get logical address
-   int pgn = PAGING_PGN (addr);
- 
-   // Read cache using tlb_cache_read()
-   int hit_flag = tlb_cache_read (proc->tlb, proc->pid, pgn, &frmnum);
-     // printf("frame number: %d\n", frmnum);
- 
- 
-   // this section indicates a HIT, retrieve data
-   if (hit_flag >= 0) {
-     // physical address
-     int phyaddr = (frmnum << PAGING_ADDR_FPN_LOBIT) + offset;
- 
-     // retrieve data stored in physical memory
-     MEMPHY_read (proc->mram, phyaddr, data);
-   }
- 
- #ifdef IODUMP
-   if (hit_flag >= 0)
-     printf ("TLB hit at read region=%d offset=%d value=%d\n", source, offset, *data);
-   else
-     printf ("TLB miss at read region=%d offset=%d value=%d\n", source, offset, *data);
- #ifdef PAGETBL_DUMP
-   print_pgtbl (proc, 0, -1); // print max TBL
- #endif
-   MEMPHY_dump (proc->mram);
- #endif
- 
-   // this section indicates a HIT, retrieve data
-  *@offset: destination address = [destination] + [offset]
-  */
- int
- tlbwrite (struct pcb_t *proc, BYTE data, uint32_t destination, uint32_t offset)
- {
-   int val;
-   int *frmnum = (int *)malloc(sizeof(int));
-   *frmnum = -1;
- 
-   /* TODO: retrieve TLB CACHED frame num of accessing page(s))*/
-   /* by using tlb_cache_read()/tlb_cache_write()
-   frmnum is return value of tlb_cache_read/write value*/
-   // retrieve pgnum from address
-   struct vm_rg_struct *currg = get_symrg_byid (proc->mm, destination);
-   if(!currg){
-     printf("Invalid address: region not found at region=%d offset=%d. WRITE operation aborted.\n", destination, offset);
-     return -1;
-   }
-   if (currg->rg_start + offset >= currg->rg_end) {
-     // ! Invalid access address (out of bound)
-     printf("Invalid address: out of bound at region=%d offset=%d. READ operation aborted.\n", destination, offset);
-     return -1;
-   }
-   int addr = currg->rg_start + offset; // get logical address
-   int pgn = PAGING_PGN (addr);
- 
- #ifdef IODUMP
-   // if (*frmnum >= 0)
-   //   printf ("TLB hit at write region=%d offset=%d value=%d\n", destination,
-   //           offset, data);
-   // else
-     printf ("TLB write region=%d offset=%d value=%d\n", destination,
-             offset, data);
- #ifdef PAGETBL_DUMP
-```c
-/*
- * Copyright (C) 2024 pdnguyen of the HCMC University of Technology
- */
-/*
- * Source Code License Grant: Authors hereby grants to Licensee
- * a personal to use and modify the Licensed Source Code for
- * the sole purpose of studying during attending the course CO2018.
- */
-// #ifdef CPU_TLB
-/*
- * CPU TLB
- * TLB module cpu/cpu-tlb.c
- */
-
- #include "mm.h"
- #include <stdlib.h>
- #include <stdio.h>
- 
- /*
-   This function is unnecessary
- */
- int
- tlb_change_all_page_tables_of (struct pcb_t *proc, struct memphy_struct *mp)
- {
-   /* TODO: update all page table directory info
-    *      in flush or wipe TLB (if needed)
-    */
-   tlb_flush_tlb_of(proc, mp);
- 
-   return 0;
- }
- 
- int
- tlb_flush_tlb_of (struct pcb_t *proc, struct memphy_struct *mp)
- {
-   /* TODO: flush tlb cached*/
-   // each process has its tlb_entry directly mapped to a specific address
-   for (int i = 0; i * 8 + (proc->pid - 1) < mp->maxsz; i++)
-     {
-       // this loops through every entries supposed to be
-       // belonged to that process and set the entry to 0
-       tlb_cache_write (mp, proc->pid, i, 0);
-     }
- 
-   return 0;
- }
- 
- /*tlballoc - CPU TLB-based allocate a region memory
-  *@proc:  Process executing the instruction
-  *@size: allocated size
-  *@reg_index: memory region ID (used to identify variable in symbole table)
-  */
- int
- tlballoc (struct pcb_t *proc, uint32_t size, uint32_t reg_index)
- {
-   int* addr = (int*)malloc(sizeof(int));
-   int val;
- 
-   /* By default using vmaid = 0 */
-   val = __alloc (proc, 0, reg_index, size, addr);
- 
-   /* TODO: update TLB CACHED frame num of the new allocated page(s)*/
-   /* by using tlb_cache_read()/tlb_cache_write()*/
- 
-   int pgn = PAGING_PGN (*addr);
-   int* frmnum = (int*)malloc(sizeof(int));
-   if (pg_getpage (proc->mm, pgn, frmnum, proc) != 0)
-     return -1; /* invalid page access */
-   tlb_cache_write (proc->tlb, proc->pid, pgn, *frmnum);
- 
-   return val;
- }
- 
- /*pgfree - CPU TLB-based free a region memory
-  *@proc: Process executing the instruction
-  *@size: allocated size
-  *@reg_index: memory region ID (used to identify variable in symbole table)
-  */
- int
- tlbfree_data (struct pcb_t *proc, uint32_t reg_index)
- {
-   __free (proc, 0, reg_index);
- 
-   /* TODO: update TLB CACHED frame num of freed page(s)*/
-   /* by using tlb_cache_read()/tlb_cache_write()*/
-   tlb_flush_tlb_of (proc, proc->tlb);
- 
-   return 0;
- }
- 
- /*tlbread - CPU TLB-based read a region memory
-  *@proc: Process executing the instruction
-  *@source: index of source register
-  *@offset: source address = [source] + [offset]
-  *@destination: destination storage
-  */
- int
- tlbread (struct pcb_t *proc, uint32_t source, uint32_t offset,
-          uint32_t destination)
- {
-   BYTE *data = (BYTE *)malloc(sizeof (BYTE));
-   int frmnum = -1;
- 
-   /* TODO: retrieve TLB CACHED frame num of accessing page(s)*/
-   /* by using tlb_cache_read()/tlb_cache_write()*/
-   /* frmnum is return value of tlb_cache_read/write value*/
- 
-   // retrieve pgnum from address
-   struct vm_rg_struct *currg = get_symrg_byid (proc->mm, source);
-   if(!currg){
-     printf("Invalid address: region not found at region=%d offset=%d. READ operation aborted.\n", source, offset);
-     return -1;
-   }
-   if (currg->rg_start + offset >= currg->rg_end) {
-     // ! Invalid access address (out of bound)
-     printf("Invalid address: out of bound at region=%d offset=%d. READ operation aborted.\n", source, offset);
-     return -1;
-   }
-   int addr = currg->rg_start + offset; // get logical address
-   int pgn = PAGING_PGN (addr);
- 
-   // Read cache using tlb_cache_read()
-   int hit_flag = tlb_cache_read (proc->tlb, proc->pid, pgn, &frmnum);
-     // printf("frame number: %d\n", frmnum);
- 
- 
-   // this section indicates a HIT, retrieve data
-   if (hit_flag >= 0) {
-     // physical address
-     int phyaddr = (frmnum << PAGING_ADDR_FPN_LOBIT) + offset;
- 
-     // retrieve data stored in physical memory
-     MEMPHY_read (proc->mram, phyaddr, data);
-   }
- 
- #ifdef IODUMP
-   if (hit_flag >= 0)
-     printf ("TLB hit at read region=%d offset=%d value=%d\n", source, offset, *data);
-   else
-     printf ("TLB miss at read region=%d offset=%d value=%d\n", source, offset, *data);
- #ifdef PAGETBL_DUMP
-   print_pgtbl (proc, 0, -1); // print max TBL
- #endif
-   MEMPHY_dump (proc->mram);
- #endif
- 
-   // this section indicates a HIT, retrieve data
-   if (hit_flag < 0) {
-     // TLB miss, retrieve frame number from page table
-     if (pg_getpage (proc->mm, pgn, &frmnum, proc) != 0)
-       return -1; /* invalid page access */
- 
-     // physical address
-     int phyaddr = (frmnum << PAGING_ADDR_FPN_LOBIT) + offset;
- 
-     // retrieve data stored in physical memory
-     MEMPHY_read (proc->mram, phyaddr, data);
- 
-     // update TLB cache
-     tlb_cache_write (proc->tlb, proc->pid, pgn, frmnum);
-   }
- 
-   // assign data to destination
-   // TODO: check if destination is a register or memory address
-   // For now, assume destination is a register index
-   // This part might need adjustment based on how 'destination' is used
-   // For example, if destination is a register, you might have a function like
-   // set_reg_value(proc, destination, *data);
-   // If destination is a memory address, it would be a write operation.
-   // Given the context of tlbread, it's likely reading into a register.
-   // Assuming a simple assignment for now.
-   proc->regs[destination] = (uint32_t)*data;
- 
-   free(data);
-   return 0;
- }
- 
- /*tlbwrite - CPU TLB-based write a region memory
-  *@proc: Process executing the instruction
-  *@data: data to write
-  *@destination: index of destination register
-  *@offset: destination address = [destination] + [offset]
-  */
- int
- tlbwrite (struct pcb_t *proc, BYTE data, uint32_t destination, uint32_t offset)
- {
-   int val;
-   int *frmnum = (int *)malloc(sizeof(int));
-   *frmnum = -1;
- 
-   /* TODO: retrieve TLB CACHED frame num of accessing page(s))*/
-   /* by using tlb_cache_read()/tlb_cache_write()
-   frmnum is return value of tlb_cache_read/write value*/
-   // retrieve pgnum from address
-   struct vm_rg_struct *currg = get_symrg_byid (proc->mm, destination);
-   if(!currg){
-     printf("Invalid address: region not found at region=%d offset=%d. WRITE operation aborted.\n", destination, offset);
-     return -1;
-   }
-   if (currg->rg_start + offset >= currg->rg_end) {
-     // ! Invalid access address (out of bound)
-     printf("Invalid address: out of bound at region=%d offset=%d. READ operation aborted.\n", destination, offset);
-     return -1;
-   }
-   int addr = currg->rg_start + offset; // get logical address
-   int pgn = PAGING_PGN (addr);
- 
- #ifdef IODUMP
-   // if (*frmnum >= 0)
-   //   printf ("TLB hit at write region=%d offset=%d value=%d\n", destination,
-   //           offset, data);
-   // else
-     printf ("TLB write region=%d offset=%d value=%d\n", destination,
-             offset, data);
- #ifdef PAGETBL_DUMP
-   print_pgtbl (proc, 0, -1); // print max TBL
- #endif
-   MEMPHY_dump (proc->mram);
- #endif
- 
-   if (pg_getpage (proc->mm, pgn, frmnum, proc) != 0)
-     return -1; /* invalid page access */
- 
-   int phyaddr = (*frmnum << PAGING_ADDR_FPN_LOBIT) + offset;
- 
-   val = MEMPHY_write (proc->mram, phyaddr, data);
- 
-   /* TODO: update TLB CACHED with frame num of recent accessing page(s)*/
-   /* by using tlb_cache_read()/tlb_cache_write()*/
-   tlb_cache_write (proc->tlb, proc->pid, pgn, *frmnum);
-   printf("%s:%d\n",__func__,__LINE__);
- 
-   return val;
- }
- 
- // #endif
-```
\ No newline at end of file
+/*
+ * Copyright (C) 2024 pdnguyen of the HCMC University of Technology
+ */
+/*
+ * Source Code License Grant: Authors hereby grants to Licensee
+ * a personal to use and modify the Licensed Source Code for
+ * the sole purpose of studying during attending the course CO2018.
+ */
+// #ifdef CPU_TLB
+/*
+ * CPU TLB
+ * TLB module cpu/cpu-tlb.c
+ */
+
+#include "mm.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Every simulated CPU owns a software TLB: an N-way set-associative array
+ * of packed (tag, frame) entries, sets laid out back to back so that a
+ * 4-way set fills exactly one cache line. The tag carries the ASID of the
+ * address space, so entries of several processes stay resident together.
+ *
+ * Flushing an address space is O(1): every ASID has a generation counter
+ * shared by all the TLBs, an entry is only valid while the generation it
+ * was filled under is current, so bumping the counter drops them all.
+ */
+#ifndef TLB_NSETS
+#define TLB_NSETS 64
+#endif
+#ifndef TLB_NWAYS
+#define TLB_NWAYS 4
+#endif
+
+#define TLB_CACHELINE 64
+
+/* Shootdown requests a CPU can queue before it falls back to a full wipe */
+#ifndef TLB_SHOOTDOWN_BATCH
+#define TLB_SHOOTDOWN_BATCH 32
+#endif
+
+/* Ranges longer than this are cheaper to drop with an ASID flush */
+#define TLB_FLUSH_CEILING 32
+
+/* The tag packs the page number above the low TLB_ASID_BITS of the ASID */
+#define TLB_ASID_BITS 20
+#define TLB_ASID_MASK ((1ULL << TLB_ASID_BITS) - 1)
+#define TLB_TAG(asid, pgn) (((uint64_t)(pgn) << TLB_ASID_BITS) | ((asid) & TLB_ASID_MASK))
+
+/* Generation table, ASIDs sharing a slot only cost each other a flush */
+#define TLB_GEN_SLOTS 4096
+#define TLB_GEN_SLOT(asid) ((asid) & (TLB_GEN_SLOTS - 1))
+
+struct tlb_entry {
+  uint64_t tag;  /* TLB_TAG(), 0 never matches as ASID 0 is not used */
+  uint32_t fpn;  /* cached frame number */
+  uint32_t gen;  /* ASID generation the entry was filled under */
+};
+
+struct tlb_shootdown_req {
+  uint32_t asid;
+  uint32_t npages;
+  addr_t pgn;
+};
+
+/* Invalidations posted by other CPUs, drained by the owner at its next slot */
+struct tlb_shootdown {
+  pthread_mutex_t lock;
+  int pending;             /* read without the lock on the drain fast path */
+  int overflow;            /* queue was full, wipe the whole TLB */
+  int nreq;
+  struct tlb_shootdown_req req[TLB_SHOOTDOWN_BATCH];
+};
+
+struct tlb_struct {
+  int nsets;               /* power of two */
+  int nways;
+  struct tlb_entry *ent;   /* nsets * nways entries, set major */
+  uint8_t *victim;         /* round robin replacement way of each set */
+  unsigned long hit;
+  unsigned long miss;
+  struct tlb_shootdown sd;
+};
+
+static uint32_t tlb_asid_gen[TLB_GEN_SLOTS];
+
+static struct tlb_struct *cpu_tlb = NULL;
+static int tlb_ncpu = 0;
+
+/* TLB of the simulated CPU running on this thread */
+static __thread struct tlb_struct *this_tlb = NULL;
+
+static inline uint32_t
+tlb_cur_gen (uint32_t asid)
+{
+  return __atomic_load_n (&tlb_asid_gen[TLB_GEN_SLOT (asid)], __ATOMIC_ACQUIRE);
+}
+
+static inline struct tlb_entry *
+tlb_set_of (struct tlb_struct *tlb, uint32_t asid, addr_t pgn)
+{
+  /* Spread the ASIDs so that the same page of two processes does not
+   * always land in the same set */
+  uint64_t h = (uint64_t)pgn ^ ((uint64_t)asid * 0x9E3779B97F4A7C15ULL >> 32);
+
+  return &tlb->ent[(h & (tlb->nsets - 1)) * tlb->nways];
+}
+
+/*
+ * init_tlb - create the TLB of every simulated CPU
+ * @ncpu  : number of CPUs
+ * @nsets : number of sets per TLB, rounded up to a power of two,
+ *          0 for TLB_NSETS
+ * @nways : associativity, 0 for TLB_NWAYS
+ */
+int
+init_tlb (int ncpu, int nsets, int nways)
+{
+  int c, sz = 1;
+
+  if (nsets == 0)
+    nsets = TLB_NSETS;
+  if (nways == 0)
+    nways = TLB_NWAYS;
+  if (ncpu <= 0 || nsets <= 0 || nways <= 0 || nways > 255)
+    return -1;
+
+  while (sz < nsets)
+    sz <<= 1;
+
+  cpu_tlb = calloc (ncpu, sizeof (struct tlb_struct));
+  if (cpu_tlb == NULL)
+    return -1;
+
+  for (c = 0; c < ncpu; c++)
+    {
+      struct tlb_struct *tlb = &cpu_tlb[c];
+      size_t entsz = (size_t)sz * nways * sizeof (struct tlb_entry);
+
+      /* Keep every set starting on a cache line boundary */
+      entsz = (entsz + TLB_CACHELINE - 1) & ~(size_t)(TLB_CACHELINE - 1);
+
+      tlb->nsets = sz;
+      tlb->nways = nways;
+      if (posix_memalign ((void **)&tlb->ent, TLB_CACHELINE, entsz) != 0)
+        return -1;
+      tlb->victim = calloc (sz, sizeof (uint8_t));
+      if (tlb->victim == NULL)
+        return -1;
+
+      memset (tlb->ent, 0, entsz);
+      pthread_mutex_init (&tlb->sd.lock, NULL);
+    }
+
+  tlb_ncpu = ncpu;
+
+  return 0;
+}
+
+/*
+ * tlb_bind_cpu - attach the calling thread to the TLB of a simulated CPU
+ * @cpuid : CPU index, a negative value detaches the thread
+ */
+void
+tlb_bind_cpu (int cpuid)
+{
+  if (cpuid < 0 || cpuid >= tlb_ncpu)
+    this_tlb = NULL;
+  else
+    this_tlb = &cpu_tlb[cpuid];
+}
+
+/*
+ * tlb_lookup - get the cached frame of a page
+ * @asid : address space ID
+ * @pgn  : page number
+ * @fpn  : returned frame number
+ * @ret  : 0 on hit, -1 on miss
+ */
+static int
+tlb_lookup (uint32_t asid, addr_t pgn, int *fpn)
+{
+  struct tlb_struct *tlb = this_tlb;
+  struct tlb_entry *set;
+  uint64_t tag = TLB_TAG (asid, pgn);
+  uint32_t gen;
+  int way;
+
+  if (tlb == NULL)
+    return -1;
+
+  gen = tlb_cur_gen (asid);
+  set = tlb_set_of (tlb, asid, pgn);
+  for (way = 0; way < tlb->nways; way++)
+    {
+      if (set[way].tag == tag && set[way].gen == gen)
+        {
+          *fpn = set[way].fpn;
+          tlb->hit++;
+          return 0;
+        }
+    }
+
+  tlb->miss++;
+  return -1;
+}
+
+/*
+ * tlb_insert - cache the frame of a page
+ * @asid : address space ID
+ * @pgn  : page number
+ * @fpn  : frame number
+ */
+static int
+tlb_insert (uint32_t asid, addr_t pgn, int fpn)
+{
+  struct tlb_struct *tlb = this_tlb;
+  struct tlb_entry *set;
+  uint64_t tag = TLB_TAG (asid, pgn);
+  uint32_t gen;
+  int way, slot = -1;
+
+  if (tlb == NULL)
+    return -1;
+
+  gen = tlb_cur_gen (asid);
+  set = tlb_set_of (tlb, asid, pgn);
+  for (way = 0; way < tlb->nways; way++)
+    {
+      if (set[way].tag == tag)
+        {
+          /* Refresh the existing translation */
+          slot = way;
+          break;
+        }
+      if (slot < 0
+          && (set[way].tag == 0 || set[way].gen != tlb_cur_gen ((uint32_t)(set[way].tag & TLB_ASID_MASK))))
+        slot = way; /* empty or flushed way */
+    }
+
+  if (slot < 0)
+    {
+      uint8_t *victim = &tlb->victim[(set - tlb->ent) / tlb->nways];
+
+      slot = *victim;
+      *victim = (slot + 1) % tlb->nways;
+    }
+
+  set[slot].tag = tag;
+  set[slot].fpn = fpn;
+  set[slot].gen = gen;
+
+  return 0;
+}
+
+/*
+ * tlb_flush_asid - drop every cached translation of an address space
+ * @asid : address space ID
+ */
+static void
+tlb_flush_asid (uint32_t asid)
+{
+  __atomic_add_fetch (&tlb_asid_gen[TLB_GEN_SLOT (asid)], 1, __ATOMIC_RELEASE);
+}
+
+/* Drop one translation from a TLB, the caller must own that TLB */
+static void
+tlb_drop_page (struct tlb_struct *tlb, uint32_t asid, addr_t pgn)
+{
+  struct tlb_entry *set = tlb_set_of (tlb, asid, pgn);
+  uint64_t tag = TLB_TAG (asid, pgn);
+  int way;
+
+  for (way = 0; way < tlb->nways; way++)
+    if (set[way].tag == tag)
+      set[way].tag = 0;
+}
+
+static void
+tlb_drop_range (struct tlb_struct *tlb, uint32_t asid, addr_t pgn, uint32_t npages)
+{
+  uint32_t i;
+
+  for (i = 0; i < npages; i++)
+    tlb_drop_page (tlb, asid, pgn + i);
+}
+
+static void
+tlb_post_shootdown (struct tlb_struct *tlb, uint32_t asid, addr_t pgn, uint32_t npages)
+{
+  struct tlb_shootdown *sd = &tlb->sd;
+
+  pthread_mutex_lock (&sd->lock);
+  if (sd->nreq < TLB_SHOOTDOWN_BATCH)
+    {
+      sd->req[sd->nreq].asid = asid;
+      sd->req[sd->nreq].pgn = pgn;
+      sd->req[sd->nreq].npages = npages;
+      sd->nreq++;
+    }
+  else
+    sd->overflow = 1;
+  __atomic_store_n (&sd->pending, 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock (&sd->lock);
+}
+
+/*
+ * tlb_invalidate_range - drop the translations of a range of pages
+ * @asid   : address space ID
+ * @pgn    : first page number
+ * @npages : number of pages
+ * The TLB of the calling CPU is cleaned right away, the other CPUs get a
+ * shootdown request they apply before running their next slot.
+ */
+int
+tlb_invalidate_range (uint32_t asid, addr_t pgn, uint32_t npages)
+{
+  int c;
+
+  if (tlb_ncpu == 0 || npages == 0)
+    return 0;
+
+  if (npages > TLB_FLUSH_CEILING)
+    {
+      tlb_flush_asid (asid);
+      return 0;
+    }
+
+  for (c = 0; c < tlb_ncpu; c++)
+    {
+      if (&cpu_tlb[c] == this_tlb)
+        tlb_drop_range (this_tlb, asid, pgn, npages);
+      else
+        tlb_post_shootdown (&cpu_tlb[c], asid, pgn, npages);
+    }
+
+  return 0;
+}
+
+/*
+ * tlb_invalidate_page - drop the translation of one page
+ * @asid : address space ID
+ * @pgn  : page number
+ */
+int
+tlb_invalidate_page (uint32_t asid, addr_t pgn)
+{
+  return tlb_invalidate_range (asid, pgn, 1);
+}
+
+/*
+ * tlb_shootdown_drain - apply the shootdown requests queued for this CPU
+ * Called by the CPU at the start of every slot before it runs a process.
+ */
+int
+tlb_shootdown_drain (void)
+{
+  struct tlb_struct *tlb = this_tlb;
+  struct tlb_shootdown_req req[TLB_SHOOTDOWN_BATCH];
+  int i, nreq, overflow;
+
+  if (tlb == NULL || !__atomic_load_n (&tlb->sd.pending, __ATOMIC_ACQUIRE))
+    return 0;
+
+  /* Take the batch out and apply it without holding the queue lock */
+  pthread_mutex_lock (&tlb->sd.lock);
+  nreq = tlb->sd.nreq;
+  overflow = tlb->sd.overflow;
+  memcpy (req, tlb->sd.req, nreq * sizeof (struct tlb_shootdown_req));
+  tlb->sd.nreq = 0;
+  tlb->sd.overflow = 0;
+  tlb->sd.pending = 0;
+  pthread_mutex_unlock (&tlb->sd.lock);
+
+  if (overflow)
+    {
+      memset (tlb->ent, 0, (size_t)tlb->nsets * tlb->nways * sizeof (struct tlb_entry));
+      return nreq;
+    }
+
+  for (i = 0; i < nreq; i++)
+    tlb_drop_range (tlb, req[i].asid, req[i].pgn, req[i].npages);
+
+  return nreq;
+}
+
+/*
+ * tlb_get_stats - collect the hit/miss counters of a CPU TLB
+ * @cpuid : CPU index
+ */
+int
+tlb_get_stats (int cpuid, unsigned long *hit, unsigned long *miss)
+{
+  if (cpuid < 0 || cpuid >= tlb_ncpu)
+    return -1;
+
+  *hit = cpu_tlb[cpuid].hit;
+  *miss = cpu_tlb[cpuid].miss;
+
+  return 0;
+}
+
+/*
+  This function is unnecessary
+*/
+int
+tlb_change_all_page_tables_of (struct pcb_t *proc)
+{
+  /* TODO: update all page table directory info
+   *      in flush or wipe TLB (if needed)
+   */
+  tlb_flush_tlb_of (proc);
+
+  return 0;
+}
+
+int
+tlb_flush_tlb_of (struct pcb_t *proc)
+{
+  /* Entries of every CPU die together with the ASID generation */
+  tlb_flush_asid (proc->mm->asid);
+
+  return 0;
+}
+
+/*tlballoc - CPU TLB-based allocate a region memory
+ *@proc:  Process executing the instruction
+ *@size: allocated size
+ *@reg_index: memory region ID (used to identify variable in symbole table)
+ */
+int
+tlballoc (struct pcb_t *proc, uint32_t size, uint32_t reg_index)
+{
+  addr_t addr;
+  int val;
+  uint32_t pte;
+
+  /* By default using vmaid = 0 */
+  val = __alloc (proc, 0, reg_index, size, &addr);
+  if (val != 0)
+    return val;
+
+  /* Warm the TLB with the first page of the region if it is online */
+  int pgn = PAGING_PGN (addr);
+  pte = pte_get_entry (proc, pgn);
+  if (PAGING_PAGE_PRESENT (pte) && !(pte & PAGING_PTE_SWAPPED_MASK))
+    tlb_insert (proc->mm->asid, pgn, PAGING_FPN (pte));
+
+  return val;
+}
+
+/*pgfree - CPU TLB-based free a region memory
+ *@proc: Process executing the instruction
+ *@size: allocated size
+ *@reg_index: memory region ID (used to identify variable in symbole table)
+ */
+int
+tlbfree_data (struct pcb_t *proc, uint32_t reg_index)
+{
+  struct vm_rg_struct *rg = get_symrg_byid (proc->mm, reg_index);
+  addr_t start = 0, last = 0;
+
+  if (rg == NULL || rg->rg_end <= rg->rg_start)
+    return -1;
+
+  start = rg->rg_start;
+  last = rg->rg_end - 1;
+
+  if (__free (proc, 0, reg_index) != 0)
+    return -1;
+
+  /* Drop the cached frame num of freed page(s) only */
+  tlb_invalidate_range (proc->mm->asid, PAGING_PGN (start),
+                        PAGING_PGN (last) - PAGING_PGN (start) + 1);
+
+  return 0;
+}
+
+/*tlbread - CPU TLB-based read a region memory
+ *@proc: Process executing the instruction
+ *@source: index of source register
+ *@offset: source address = [source] + [offset]
+ *@destination: destination storage
+ */
+int
+tlbread (struct pcb_t *proc, uint32_t source, uint32_t offset,
+         uint32_t destination)
+{
+  BYTE data = 0;
+  int frmnum = -1;
+
+  // retrieve pgnum from address
+  struct vm_rg_struct *currg = get_symrg_byid (proc->mm, source);
+  if (!currg)
+    {
+      printf ("Invalid address: region not found at region=%d offset=%d. READ operation aborted.\n", source, offset);
+      return -1;
+    }
+  if (currg->rg_start + offset >= currg->rg_end)
+    {
+      // ! Invalid access address (out of bound)
+      printf ("Invalid address: out of bound at region=%d offset=%d. READ operation aborted.\n", source, offset);
+      return -1;
+    }
+  addr_t addr = currg->rg_start + offset; // get logical address
+  int pgn = PAGING_PGN (addr);
+
+  int hit_flag = tlb_lookup (proc->mm->asid, pgn, &frmnum);
+  if (hit_flag < 0)
+    {
+      // TLB miss, retrieve frame number from page table
+      if (pg_getpage (proc->mm, pgn, &frmnum, proc) != 0)
+        return -1; /* invalid page access */
+
+      tlb_insert (proc->mm->asid, pgn, frmnum);
+    }
+  else
+    {
+      /* The replacement policy sees TLB hits too, pg_getpage() did the
+         miss */
+      pgrepl_touch (proc->mm, pgn);
+    }
+
+  // physical address
+  addr_t phyaddr = ((addr_t)frmnum << PAGING_ADDR_FPN_LOBIT) + PAGING_OFFST (addr);
+  MEMPHY_read (proc->krnl->mram, phyaddr, &data);
+
+#ifdef IODUMP
+  if (hit_flag >= 0)
+    printf ("TLB hit at read region=%d offset=%d value=%d\n", source, offset, data);
+  else
+    printf ("TLB miss at read region=%d offset=%d value=%d\n", source, offset, data);
+#ifdef PAGETBL_DUMP
+  print_pgtbl (proc, 0, -1); // print max TBL
+#endif
+  MEMPHY_dump (proc->krnl->mram);
+#endif
+
+  proc->regs[destination] = (uint32_t)data;
+
+  return 0;
+}
+
+/*tlbwrite - CPU TLB-based write a region memory
+ *@proc: Process executing the instruction
+ *@data: data to write
+ *@destination: index of destination register
+ *@offset: destination address = [destination] + [offset]
+ */
+int
+tlbwrite (struct pcb_t *proc, BYTE data, uint32_t destination, uint32_t offset)
+{
+  int frmnum = -1;
+
+  // retrieve pgnum from address
+  struct vm_rg_struct *currg = get_symrg_byid (proc->mm, destination);
+  if (!currg)
+    {
+      printf ("Invalid address: region not found at region=%d offset=%d. WRITE operation aborted.\n", destination, offset);
+      return -1;
+    }
+  if (currg->rg_start + offset >= currg->rg_end)
+    {
+      // ! Invalid access address (out of bound)
+      printf ("Invalid address: out of bound at region=%d offset=%d. WRITE operation aborted.\n", destination, offset);
+      return -1;
+    }
+  addr_t addr = currg->rg_start + offset; // get logical address
+  int pgn = PAGING_PGN (addr);
+
+  int hit_flag = tlb_lookup (proc->mm->asid, pgn, &frmnum);
+  if (hit_flag < 0)
+    {
+      if (pg_getpage (proc->mm, pgn, &frmnum, proc) != 0)
+        return -1; /* invalid page access */
+
+      tlb_insert (proc->mm->asid, pgn, frmnum);
+    }
+  else
+    pgrepl_touch (proc->mm, pgn);
+
+#ifdef IODUMP
+  if (hit_flag >= 0)
+    printf ("TLB hit at write region=%d offset=%d value=%d\n", destination,
+            offset, data);
+  else
+    printf ("TLB miss at write region=%d offset=%d value=%d\n", destination,
+            offset, data);
+#ifdef PAGETBL_DUMP
+  print_pgtbl (proc, 0, -1); // print max TBL
+#endif
+  MEMPHY_dump (proc->krnl->mram);
+#endif
+
+  addr_t phyaddr = ((addr_t)frmnum << PAGING_ADDR_FPN_LOBIT) + PAGING_OFFST (addr);
+
+  return MEMPHY_write (proc->krnl->mram, phyaddr, data);
+}
+
+// #endif
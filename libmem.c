@@ -22,28 +22,25 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <time.h>
 
-static pthread_mutex_t mmvm_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Address space changes are serialized per mm, see the locking notes
+ * in mm64.c. This one only guards the reclaim daemon state. */
+static pthread_mutex_t reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /*enlist_vm_freerg_list - add new rg to freerg_list
  *@mm: memory region
- *@rg_elmt: new region
+ *@rg_elmt: new region, consumed
  *
  */
 int enlist_vm_freerg_list(struct mm_struct *mm, struct vm_rg_struct *rg_elmt)
 {
-  struct vm_rg_struct *rg_node = mm->mmap->vm_freerg_list;
+  int ret = vm_freerg_put(mm->mmap, rg_elmt->rg_start, rg_elmt->rg_end);
 
-  if (rg_elmt->rg_start >= rg_elmt->rg_end)
-    return -1;
-
-  if (rg_node != NULL)
-    rg_elmt->rg_next = rg_node;
+  /* The free region allocator keeps its own nodes */
+  free(rg_elmt);
 
-  /* Enlist the new region */
-  mm->mmap->vm_freerg_list = rg_elmt;
-
-  return 0;
+  return ret;
 }
 
 /*get_symrg_byid - get mem region by region ID
@@ -70,19 +67,19 @@ struct vm_rg_struct *get_symrg_byid(struct mm_struct *mm, int rgid)
 int __alloc(struct pcb_t *caller, int vmaid, int rgid, addr_t size, addr_t *alloc_addr)
 {
   /*Allocate at the toproof */
-  pthread_mutex_lock(&mmvm_lock);
+  pthread_rwlock_wrlock(&caller->mm->mmap_lock);
   struct vm_rg_struct rgnode;
-  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+  struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
   int inc_sz=0;
 
   if (get_free_vmrg_area(caller, vmaid, size, &rgnode) == 0)
   {
-    caller->krnl->mm->symrgtbl[rgid].rg_start = rgnode.rg_start;
-    caller->krnl->mm->symrgtbl[rgid].rg_end = rgnode.rg_end;
+    caller->mm->symrgtbl[rgid].rg_start = rgnode.rg_start;
+    caller->mm->symrgtbl[rgid].rg_end = rgnode.rg_end;
  
     *alloc_addr = rgnode.rg_start;
 
-    pthread_mutex_unlock(&mmvm_lock);
+    pthread_rwlock_unlock(&caller->mm->mmap_lock);
     return 0;
   }
 
@@ -114,12 +111,12 @@ int __alloc(struct pcb_t *caller, int vmaid, int rgid, addr_t size, addr_t *allo
   syscall(caller->krnl, caller->pid, 17, &regs); /* SYSCALL 17 sys_memmap */
 
   /*Successful increase limit */
-  caller->krnl->mm->symrgtbl[rgid].rg_start = old_sbrk;
-  caller->krnl->mm->symrgtbl[rgid].rg_end = old_sbrk + size;
+  caller->mm->symrgtbl[rgid].rg_start = old_sbrk;
+  caller->mm->symrgtbl[rgid].rg_end = old_sbrk + size;
 
   *alloc_addr = old_sbrk;
 
-  pthread_mutex_unlock(&mmvm_lock);
+  pthread_rwlock_unlock(&caller->mm->mmap_lock);
   return 0;
 
 }
@@ -133,34 +130,29 @@ int __alloc(struct pcb_t *caller, int vmaid, int rgid, addr_t size, addr_t *allo
  */
 int __free(struct pcb_t *caller, int vmaid, int rgid)
 {
-  pthread_mutex_lock(&mmvm_lock);
-
   if (rgid < 0 || rgid > PAGING_MAX_SYMTBL_SZ)
-  {
-    pthread_mutex_unlock(&mmvm_lock);
     return -1;
-  }
+
+  pthread_rwlock_wrlock(&caller->mm->mmap_lock);
 
   /* TODO: Manage the collect freed region to freerg_list */
-  struct vm_rg_struct *rgnode = get_symrg_byid(caller->krnl->mm, rgid);
+  struct vm_rg_struct *rgnode = get_symrg_byid(caller->mm, rgid);
 
   if (rgnode->rg_start == 0 && rgnode->rg_end == 0)
   {
-    pthread_mutex_unlock(&mmvm_lock);
+    pthread_rwlock_unlock(&caller->mm->mmap_lock);
     return -1;
   }
-  struct vm_rg_struct *freerg_node = malloc(sizeof(struct vm_rg_struct));
-  freerg_node->rg_start = rgnode->rg_start;
-  freerg_node->rg_end = rgnode->rg_end;
-  freerg_node->rg_next = NULL;
+  struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
+
+  /*enlist the obsoleted memory region, merged with its free neighbours */
+  if (cur_vma != NULL)
+    vm_freerg_put(cur_vma, rgnode->rg_start, rgnode->rg_end);
 
   rgnode->rg_start = rgnode->rg_end = 0;
   rgnode->rg_next = NULL;
 
-  /*enlist the obsoleted memory region */
-  enlist_vm_freerg_list(caller->krnl->mm, freerg_node);
-
-  pthread_mutex_unlock(&mmvm_lock);
+  pthread_rwlock_unlock(&caller->mm->mmap_lock);
   return 0;
 }
 
@@ -219,53 +211,66 @@ printf("%s:%d\n",__func__,__LINE__);
  *@framenum: return FPN
  *@caller: caller
  *
+ *The replacement policy sees a resident page as referenced, a page
+ *faulted in as inserted: the access that faults is not a second
+ *reference.
  */
 int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
 {
-
   uint32_t pte = pte_get_entry(caller, pgn);
 
-  if (!PAGING_PAGE_PRESENT(pte))
-  { /* Page is not online, make it actively living */
-    addr_t vicpgn, swpfpn;
-    addr_t vicfpn;
-    uint32_t vicpte;
+  /* Resident page: nothing to change, no lock needed */
+  if (PAGING_PAGE_PRESENT(pte) && !(pte & PAGING_PTE_SWAPPED_MASK))
+  {
+    *fpn = PAGING_FPN(pte);
+    pgrepl_touch(mm, pgn);
+    return 0;
+  }
 
-    /* Initialize the target frame storing our variable */
-    addr_t tgtfpn = PAGING_SWP(pte); // the target frame storing our variable
+  pte_lock(mm, pgn);
+  pte = pte_get_entry(caller, pgn);
 
-    /* Play with your paging theory here */
-    /* Find victim page */
-    if (find_victim_page(caller->krnl->mm, &vicpgn) == -1)
-    {
-      return -1;
-    }
+  /* A swapped page keeps its present bit, the swapped bit tells it apart */
+  if (!PAGING_PAGE_PRESENT(pte) || (pte & PAGING_PTE_SWAPPED_MASK))
+  { /* Page is not online, make it actively living */
+    addr_t tgtfpn;
 
-    /* Get free frame in MEMSWP */
-    if (MEMPHY_get_freefp(caller->krnl->active_mswp, &swpfpn) == -1)
+    /* Take a free frame, swap a victim out only when there is none */
+    if (get_free_frame(caller, &tgtfpn) != 0)
     {
+      pte_unlock(mm, pgn);
       return -1;
     }
 
-    vicpte = pte_get_entry(caller, vicpgn);
-    vicfpn = PAGING_FPN(vicpte);
+    if (pte & PAGING_PTE_SWAPPED_MASK)
+    {
+      /* Copy target frame from swap to mem and release its swap frame */
+      addr_t swpfpn = PAGING_SWP(pte);
 
-    /* Do swap frame from MEMRAM to MEMSWP and vice versa*/
-    /* Copy victim frame to swap */
-    __swap_cp_page(caller->krnl->mram, vicfpn, caller->krnl->active_mswp, swpfpn);
-    /* Copy target frame from swap to mem */
-    __swap_cp_page(caller->krnl->active_mswp, tgtfpn, caller->krnl->mram, vicfpn);
+      __swap_cp_page(caller->krnl->active_mswp, swpfpn, caller->krnl->mram, tgtfpn);
+      MEMPHY_free_frame(caller->krnl->active_mswp, swpfpn);
+    }
+    else
+    {
+      /* First touch of the page, hand it out zero filled */
+      BYTE zero[PAGING_PAGESZ] = { 0 };
 
-    /* Update page table */
-    pte_set_swap(caller, vicpgn, 0, swpfpn);
+      MEMPHY_write_frame(caller->krnl->mram, tgtfpn, zero);
+    }
 
     /* Update its online status of the target page */
-    pte_set_fpn(caller, pgn, vicfpn);
+    pte_set_fpn(caller, pgn, tgtfpn);
 
-    enlist_pgn_node(&caller->krnl->mm->fifo_pgn, pgn);
+    pgrepl_insert(mm, pgn);
+  }
+  else
+  {
+    /* Faulted in by another CPU meanwhile */
+    pgrepl_touch(mm, pgn);
   }
 
   *fpn = PAGING_FPN(pte_get_entry(caller,pgn));
+  pte_unlock(mm, pgn);
 
   return 0;
 }
@@ -330,6 +335,150 @@ int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
   return 0;
 }
 
+/*pg_rwbuf - move a run of bytes between a buffer and the address space
+ *@mm: memory region
+ *@addr: virtual address of the first byte
+ *@buf: buffer
+ *@size: number of bytes
+ *@memop: SYSMEM_IO_READV or SYSMEM_IO_WRITEV
+ *@caller: caller
+ *
+ *The run is cut at page boundaries into (phyaddr, len) segments, moved
+ *IOV_BATCH at a time by one sys_memmap call. A segment only waits in the
+ *batch while its page stays resident: the batch goes out before a fault,
+ *which could pick one of those pages as its victim.
+ */
+#define IOV_BATCH 16
+
+static int pg_rwbuf(struct mm_struct *mm, addr_t addr, BYTE *buf, addr_t size,
+                    int memop, struct pcb_t *caller)
+{
+#ifdef MM64
+  struct memmap_iovec iov[IOV_BATCH];
+  struct sc_regs regs;
+  int niov = 0;
+
+  regs.a1 = memop;
+  regs.a2 = (arg_t)(uintptr_t)iov;
+
+  while (size > 0)
+  {
+    addr_t pgn = PAGING_PGN(addr);
+    addr_t off = PAGING_OFFST(addr);
+    addr_t len = PAGING_PAGESZ - off < size ? PAGING_PAGESZ - off : size;
+    uint32_t pte = pte_get_entry(caller, pgn);
+    int fpn;
+
+    if (niov > 0 && (!PAGING_PAGE_PRESENT(pte) || (pte & PAGING_PTE_SWAPPED_MASK)))
+    {
+      regs.a3 = niov;
+      if (syscall(caller->krnl, caller->pid, 17, &regs) != 0) /* SYSCALL 17 sys_memmap */
+        return -1;
+      niov = 0;
+    }
+
+    if (pg_getpage(mm, pgn, &fpn, caller) != 0)
+      return -1; /* invalid page access */
+
+    iov[niov].phyaddr = ((addr_t)fpn << PAGING_ADDR_FPN_LOBIT) + off;
+    iov[niov].buf = buf;
+    iov[niov].len = len;
+    niov++;
+
+    if (niov == IOV_BATCH)
+    {
+      regs.a3 = niov;
+      if (syscall(caller->krnl, caller->pid, 17, &regs) != 0)
+        return -1;
+      niov = 0;
+    }
+
+    addr += len;
+    buf += len;
+    size -= len;
+  }
+
+  if (niov > 0)
+  {
+    regs.a3 = niov;
+    if (syscall(caller->krnl, caller->pid, 17, &regs) != 0)
+      return -1;
+  }
+
+  return 0;
+#else
+  /* Registers cannot carry a segment list, go byte by byte */
+  addr_t i;
+
+  for (i = 0; i < size; i++)
+  {
+    if (memop == SYSMEM_IO_READV)
+    {
+      if (pg_getval(mm, addr + i, &buf[i], caller) != 0)
+        return -1;
+    }
+    else if (pg_setval(mm, addr + i, buf[i], caller) != 0)
+      return -1;
+  }
+
+  return 0;
+#endif
+}
+
+/*__rwbuf - move a run of bytes in region memory
+ *@caller: caller
+ *@vmaid: ID vm area to alloc memory region
+ *@rgid: memory region ID (used to identify variable in symbole table)
+ *@offset: offset of the first byte in the region
+ *@buf: buffer
+ *@size: number of bytes
+ *@memop: SYSMEM_IO_READV or SYSMEM_IO_WRITEV
+ */
+static int __rwbuf(struct pcb_t *caller, int vmaid, int rgid, addr_t offset,
+                   BYTE *buf, addr_t size, int memop)
+{
+  struct vm_rg_struct *currg;
+  int ret = -1;
+
+  pthread_rwlock_rdlock(&caller->mm->mmap_lock);
+  currg = get_symrg_byid(caller->mm, rgid);
+
+  /* The whole run must stay inside the region */
+  if (currg != NULL && currg->rg_start < currg->rg_end &&
+      offset <= currg->rg_end - currg->rg_start &&
+      size <= currg->rg_end - currg->rg_start - offset)
+    ret = pg_rwbuf(caller->mm, currg->rg_start + offset, buf, size, memop, caller);
+
+  pthread_rwlock_unlock(&caller->mm->mmap_lock);
+  return ret;
+}
+
+/*__read_buf - read a run of bytes in region memory
+ *@caller: caller
+ *@vmaid: ID vm area to alloc memory region
+ *@rgid: memory region ID (used to identify variable in symbole table)
+ *@offset: offset of the first byte in the region
+ *@data: destination buffer
+ *@size: number of bytes
+ */
+int __read_buf(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE *data, addr_t size)
+{
+  return __rwbuf(caller, vmaid, rgid, offset, data, size, SYSMEM_IO_READV);
+}
+
+/*__write_buf - write a run of bytes in region memory
+ *@caller: caller
+ *@vmaid: ID vm area to alloc memory region
+ *@rgid: memory region ID (used to identify variable in symbole table)
+ *@offset: offset of the first byte in the region
+ *@data: source buffer
+ *@size: number of bytes
+ */
+int __write_buf(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, const BYTE *data, addr_t size)
+{
+  return __rwbuf(caller, vmaid, rgid, offset, (BYTE *)data, size, SYSMEM_IO_WRITEV);
+}
+
 /*__read - read value in region memory
  *@caller: caller
  *@vmaid: ID vm area to alloc memory region
@@ -340,14 +489,17 @@ int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
  */
 int __read(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE *data)
 {
-  struct vm_rg_struct *currg = get_symrg_byid(caller->krnl->mm, rgid);
+  /* Regions only change under the write side, faults lock their PTE */
+  pthread_rwlock_rdlock(&caller->mm->mmap_lock);
+  struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
 
-//  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+//  struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
 
   /* TODO Invalid memory identify */
 
-  pg_getval(caller->krnl->mm, currg->rg_start + offset, data, caller);
+  pg_getval(caller->mm, currg->rg_start + offset, data, caller);
 
+  pthread_rwlock_unlock(&caller->mm->mmap_lock);
   return 0;
 }
 
@@ -382,20 +534,20 @@ int libread(
  */
 int __write(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE value)
 {
-  pthread_mutex_lock(&mmvm_lock);
-  struct vm_rg_struct *currg = get_symrg_byid(caller->krnl->mm, rgid);
+  pthread_rwlock_rdlock(&caller->mm->mmap_lock);
+  struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
 
-  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+  struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
 
   if (currg == NULL || cur_vma == NULL) /* Invalid memory identify */
   {
-    pthread_mutex_unlock(&mmvm_lock);
+    pthread_rwlock_unlock(&caller->mm->mmap_lock);
     return -1;
   }
 
-  pg_setval(caller->krnl->mm, currg->rg_start + offset, value, caller);
+  pg_setval(caller->mm, currg->rg_start + offset, value, caller);
 
-  pthread_mutex_unlock(&mmvm_lock);
+  pthread_rwlock_unlock(&caller->mm->mmap_lock);
   return 0;
 }
 
@@ -421,6 +573,44 @@ int libwrite(
   return val;
 }
 
+/*libread_buf - PAGING-based read of a run of bytes */
+int libread_buf(
+    struct pcb_t *proc, // Process executing the instruction
+    uint32_t source,    // Index of source register
+    addr_t offset,      // Source address = [source] + [offset]
+    BYTE *data,         // Destination buffer
+    addr_t size)
+{
+  return __read_buf(proc, 0, source, offset, data, size);
+}
+
+/*libwrite_buf - PAGING-based write of a run of bytes */
+int libwrite_buf(
+    struct pcb_t *proc,   // Process executing the instruction
+    const BYTE *data,     // Data to be written into memory
+    uint32_t destination, // Index of destination register
+    addr_t offset,
+    addr_t size)
+{
+  return __write_buf(proc, 0, destination, offset, data, size);
+}
+
+static int free_pte_frame(addr_t pgn, addr_t *pte, void *arg)
+{
+  struct pcb_t *caller = arg;
+  uint32_t pteval = (uint32_t)*pte;
+
+  if (!PAGING_PAGE_PRESENT(pteval))
+    return 0;
+
+  if (pteval & PAGING_PTE_SWAPPED_MASK)
+    MEMPHY_free_frame(caller->krnl->active_mswp, PAGING_SWP(pteval));
+  else
+    MEMPHY_free_frame(caller->krnl->mram, PAGING_FPN(pteval));
+
+  return 0;
+}
+
 /*free_pcb_memphy - collect all memphy of pcb
  *@caller: caller
  *@vmaid: ID vm area to alloc memory region
@@ -428,138 +618,247 @@ int libwrite(
  */
 int free_pcb_memph(struct pcb_t *caller)
 {
-  pthread_mutex_lock(&mmvm_lock);
-  int pagenum, fpn;
-  uint32_t pte;
+  /* The daemon must not pick frames of a dying process anymore, once
+   * off its list the page table is ours alone */
+  mm_reclaim_unregister(caller);
+
+  /* Only the populated part of the page table is visited */
+  pgd_for_each_pte(caller->mm, free_pte_frame, caller);
 
-  /* Use PAGING64_MAX_PGN to match the allocated pgd array size */
-  for (pagenum = 0; pagenum < PAGING64_MAX_PGN; pagenum++)
+  return 0;
+}
+
+
+/*
+ * Background reclaim: a daemon attached to the timer like the CPUs keeps
+ * the number of free MEMRAM frames between the low and high watermarks by
+ * swapping out pages ahead of demand, so that faults and allocations on
+ * the CPUs find a free frame instead of doing the swap-out themselves.
+ */
+#define RECLAIM_BATCH 32 /* pages swapped out per slot at most */
+
+static struct pcb_t **reclaim_owner = NULL;
+static int reclaim_nr = 0;
+static int reclaim_cap = 0;
+static int reclaim_cursor = 0;
+static int reclaim_active = 0;
+static int reclaim_low = -1;
+static int reclaim_high = -1;
+
+/*mm_reclaim_register - let the reclaim daemon take frames from a process
+ *@caller: owner of the address space
+ */
+int mm_reclaim_register(struct pcb_t *caller)
+{
+  pthread_mutex_lock(&reclaim_lock);
+  if (reclaim_nr == reclaim_cap)
   {
-    pte = caller->krnl->mm->pgd[pagenum];
+    int ncap = reclaim_cap ? 2 * reclaim_cap : 16;
+    struct pcb_t **nown = realloc(reclaim_owner, ncap * sizeof(struct pcb_t *));
 
-    if (PAGING_PAGE_PRESENT(pte))
+    if (nown == NULL)
     {
-      fpn = PAGING_FPN(pte);
-      MEMPHY_put_freefp(caller->krnl->mram, fpn);
+      pthread_mutex_unlock(&reclaim_lock);
+      return -1;
     }
-    else
-    {
-      fpn = PAGING_SWP(pte);
+    reclaim_owner = nown;
+    reclaim_cap = ncap;
+  }
+  reclaim_owner[reclaim_nr++] = caller;
+  pthread_mutex_unlock(&reclaim_lock);
 
-      if (fpn == -1)
-        continue;
+  return 0;
+}
+
+/*mm_reclaim_unregister - take a process off the reclaim daemon list
+ *@caller: owner of the address space
+ */
+void mm_reclaim_unregister(struct pcb_t *caller)
+{
+  int i;
 
-      MEMPHY_put_freefp(caller->krnl->active_mswp, fpn);
+  pthread_mutex_lock(&reclaim_lock);
+  for (i = 0; i < reclaim_nr; i++)
+  {
+    if (reclaim_owner[i] == caller)
+    {
+      reclaim_owner[i] = reclaim_owner[--reclaim_nr];
+      break;
     }
   }
+  pthread_mutex_unlock(&reclaim_lock);
+}
+
+/*mm_reclaim_set_watermark - set the free frame watermarks
+ *@low: start reclaiming below this many free frames
+ *@high: stop once this many frames are free
+ */
+int mm_reclaim_set_watermark(int low, int high)
+{
+  if (low < 0 || high < low)
+    return -1;
+
+  pthread_mutex_lock(&reclaim_lock);
+  reclaim_low = low;
+  reclaim_high = high;
+  pthread_mutex_unlock(&reclaim_lock);
 
-  pthread_mutex_unlock(&mmvm_lock);
   return 0;
 }
 
-
-/*find_victim_page - find victim page
- *@caller: caller
- *@pgn: return page number
- *
+/*mm_reclaim - one slot of the reclaim daemon
+ *@krnl: kernel
+ *@ret: number of pages swapped out
  */
-int find_victim_page(struct mm_struct *mm, addr_t *retpgn)
+int mm_reclaim(struct krnl_t *krnl)
 {
-  struct pgn_t *pg = mm->fifo_pgn;
+  int nfree, nr = 0, miss = 0;
+  addr_t fpn;
 
-  /* TODO: Implement the theorical mechanism to find the victim page */
-  if (!pg)
+  if (krnl->mram == NULL)
+    return 0;
+
+  pthread_mutex_lock(&reclaim_lock);
+
+  if (reclaim_low < 0)
   {
-    return -1;
+    /* Default watermarks: 1/32 and 1/16 of MEMRAM */
+    int nframes = krnl->mram->maxsz / PAGING_PAGESZ;
+
+    reclaim_low = nframes / 32 > 0 ? nframes / 32 : 1;
+    reclaim_high = 2 * reclaim_low;
   }
-  struct pgn_t *prev = NULL;
-  while (pg->pg_next)
+
+  nfree = MEMPHY_nr_free_frames(krnl->mram);
+  if (nfree < reclaim_low)
+    reclaim_active = 1;
+
+  /* Round robin over the address spaces, give up after a full round
+   * without anything to evict */
+  while (reclaim_active && nfree < reclaim_high && nr < RECLAIM_BATCH &&
+         reclaim_nr > 0 && miss < reclaim_nr)
   {
-    prev = pg;
-    pg = pg->pg_next;
-  }
-  *retpgn = pg->pgn;
-  
-  /* Remove node from list */
-  if (prev) {
-    prev->pg_next = NULL;
-  } else {
-    /* pg is the only node, list becomes empty */
-    mm->fifo_pgn = NULL;
+    struct pcb_t *owner;
+
+    reclaim_cursor = (reclaim_cursor + 1) % reclaim_nr;
+    owner = reclaim_owner[reclaim_cursor];
+
+    /* Leave alone an address space a CPU is running, it reads its pages
+     * through the TLB without locking */
+    if (pthread_mutex_trylock(&owner->mm->run_lock) != 0)
+    {
+      miss++;
+      continue;
+    }
+
+    if (swap_out_victim(owner, &fpn) != 0)
+    {
+      pthread_mutex_unlock(&owner->mm->run_lock);
+      miss++;
+      continue;
+    }
+    pthread_mutex_unlock(&owner->mm->run_lock);
+
+    MEMPHY_free_frame(krnl->mram, fpn);
+    nfree++;
+    nr++;
+    miss = 0;
   }
 
-  /* DO NOT FREE pg here - it causes double-free/corruption!
-   * The pgn_t nodes are managed by the FIFO list structure
-   * and will be freed when the process terminates */
-  // free(pg);  // REMOVED - causes malloc corruption
+  if (nfree >= reclaim_high || miss >= reclaim_nr)
+    reclaim_active = 0;
 
-  return 0;
+  pthread_mutex_unlock(&reclaim_lock);
+  return nr;
 }
 
-/*get_free_vmrg_area - get a free vm region
- *@caller: caller
- *@vmaid: ID vm area to alloc memory region
- *@size: allocated size
- *
+/*mm_reclaim_direct - take a frame from another process on the spot
+ *@caller: faulting process, it has nothing left to swap out itself
+ *@fpn: returned MEMRAM frame
+ *Only address spaces no CPU is running are looked at, like the daemon
+ *does. The faulting process holds its own locks, every other one is
+ *only tried so nobody ends up waiting on us. A CPU lets go of the
+ *address space it runs after each instruction, a few rounds are enough
+ *to catch one of them in between.
  */
-int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_struct *newrg)
-{
-  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+#define RECLAIM_DIRECT_ROUNDS 64
 
-  struct vm_rg_struct *rgit = cur_vma->vm_freerg_list;
+int mm_reclaim_direct(struct pcb_t *caller, addr_t *fpn)
+{
+  int i, round, busy = 1;
 
-  if (rgit == NULL)
-    return -1;
+  for (round = 0; round < RECLAIM_DIRECT_ROUNDS && busy; round++)
+  {
+    busy = 0;
 
-  /* Probe unintialized newrg */
-  newrg->rg_start = newrg->rg_end = -1;
+    pthread_mutex_lock(&reclaim_lock);
+    for (i = 0; i < reclaim_nr; i++)
+    {
+      struct pcb_t *owner;
+      int ret;
 
-  /* Traverse on list of free vm region to find a fit space */
-  while (rgit != NULL)
-  {
-    if (rgit->rg_start + size <= rgit->rg_end)
-    { /* Current region has enough space */
-      newrg->rg_start = rgit->rg_start;
-      newrg->rg_end = rgit->rg_start + size;
+      reclaim_cursor = (reclaim_cursor + 1) % reclaim_nr;
+      owner = reclaim_owner[reclaim_cursor];
 
-      /* Update left space in chosen region */
-      if (rgit->rg_start + size < rgit->rg_end)
+      if (owner == caller)
+        continue;
+      if (pthread_mutex_trylock(&owner->mm->run_lock) != 0)
       {
-        rgit->rg_start = rgit->rg_start + size;
+        busy = 1;
+        continue;
       }
-      else
-      { /*Use up all space, remove current node */
-        /*Clone next rg node */
-        struct vm_rg_struct *nextrg = rgit->rg_next;
-
-        /*Cloning */
-        if (nextrg != NULL)
-        {
-          rgit->rg_start = nextrg->rg_start;
-          rgit->rg_end = nextrg->rg_end;
-
-          rgit->rg_next = nextrg->rg_next;
-
-          free(nextrg);
-        }
-        else
-        {                                /*End of free list */
-          rgit->rg_start = rgit->rg_end; // dummy, size 0 region
-          rgit->rg_next = NULL;
-        }
+
+      ret = swap_out_victim(owner, fpn);
+      pthread_mutex_unlock(&owner->mm->run_lock);
+      if (ret == 0)
+      {
+        pthread_mutex_unlock(&reclaim_lock);
+        return 0;
       }
-      break;
     }
-    else
+    pthread_mutex_unlock(&reclaim_lock);
+
+    /* Nothing to take from the idle ones, wait for a running one */
+    if (busy)
     {
-      rgit = rgit->rg_next; // Traverse next rg
+      struct timespec ts = { 0, 1000 };
+
+      nanosleep(&ts, NULL);
     }
   }
 
-  if (newrg->rg_start == -1) // new region not found
+  return -1;
+}
+
+/*find_victim_page - find victim page
+ *@caller: caller
+ *@pgn: return page number
+ *
+ */
+int find_victim_page(struct mm_struct *mm, addr_t *retpgn)
+{
+  /* The configured replacement policy picks and forgets the victim */
+  return pgrepl_evict(mm, retpgn);
+}
+
+/*get_free_vmrg_area - get a free vm region
+ *@caller: caller
+ *@vmaid: ID vm area to alloc memory region
+ *@size: allocated size
+ *
+ */
+int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_struct *newrg)
+{
+  struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
+
+  if (cur_vma == NULL || size <= 0)
     return -1;
 
-  return 0;
+  /* Probe unintialized newrg */
+  newrg->rg_start = newrg->rg_end = -1;
+
+  /* Size classes pick a fitting free region without a list traversal */
+  return vm_freerg_get(cur_vma, size, newrg);
 }
 
 // #endif
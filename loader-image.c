@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * Program image cache
+ *
+ * A program file is parsed by load() the first time a process runs it.
+ * The image keeps that first PCB as a template and owns its code
+ * segment, decoded once; every process of the same path takes what the
+ * program file sets from the template and shares the code, which is never
+ * written. Everything else of a process starts afresh. The image counts
+ * the processes running it. One no process runs stays cached for as long
+ * as more may be loaded, so a path that comes back later in the process
+ * list is not parsed again; once the loader is done (ld_image_flush())
+ * an image goes away with the last process running it. Batch mode
+ * preloads the programs of all its configs, they are shared by every
+ * instance it forks.
+ *
+ * PIDs are given here in loading order, the template's one is not used.
+ */
+
+#include "common.h"
+#include "cpu.h"
+#include "loader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define LD_IMAGE_BUCKETS 64
+
+struct ld_image {
+	struct code_seg_t code;		/* every copy points here */
+	struct ld_image * next;
+	char * path;
+	struct pcb_t * tmpl;
+	unsigned long ref;
+};
+
+static struct ld_image * ld_images[LD_IMAGE_BUCKETS];
+static pthread_mutex_t ld_image_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t ld_next_pid = 1;
+static int ld_image_flushed = 0;	/* nothing more is loaded */
+
+static unsigned int ld_image_hash(const char * path) {
+	unsigned int h = 2166136261u;
+
+	while (*path)
+		h = (h ^ (unsigned char)*path++) * 16777619u;
+	return h % LD_IMAGE_BUCKETS;
+}
+
+static struct ld_image * ld_image_of(struct code_seg_t * code) {
+	return (struct ld_image *)((char *)code - offsetof(struct ld_image, code));
+}
+
+/* First process of a path: parse the file, the code moves to the image */
+static struct ld_image * ld_image_create(const char * path) {
+	struct ld_image * img = calloc(1, sizeof(struct ld_image));
+
+	if (img == NULL)
+		return NULL;
+
+	img->path = strdup(path);
+	img->tmpl = load(path);
+	if (img->path == NULL || img->tmpl == NULL) {
+		free(img->path);
+		free(img);
+		return NULL;
+	}
+
+	img->code = *img->tmpl->code;
+	free(img->tmpl->code);
+	img->tmpl->code = &img->code;
+	cpu_decode(&img->code);
+
+	return img;
+}
+
+/* Image of a path, parsed if no process runs it yet; the lock is held */
+static struct ld_image * ld_image_lookup(const char * path) {
+	unsigned int b = ld_image_hash(path);
+	struct ld_image * img;
+
+	for (img = ld_images[b]; img != NULL; img = img->next)
+		if (strcmp(img->path, path) == 0)
+			return img;
+
+	img = ld_image_create(path);
+	if (img != NULL) {
+		img->next = ld_images[b];
+		ld_images[b] = img;
+	}
+	return img;
+}
+
+/*
+ * ld_image_get - create a process running a program
+ * @path : program file, parsed only when no process runs it yet
+ */
+struct pcb_t * ld_image_get(const char * path) {
+	struct ld_image * img;
+	struct pcb_t * proc;
+
+	proc = calloc(1, sizeof(struct pcb_t));
+	if (proc == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&ld_image_lock);
+	img = ld_image_lookup(path);
+	if (img == NULL) {
+		pthread_mutex_unlock(&ld_image_lock);
+		free(proc);
+		return NULL;
+	}
+
+	img->ref++;
+	proc->pid = ld_next_pid++;
+	pthread_mutex_unlock(&ld_image_lock);
+
+	/* What the program file sets */
+	proc->priority = img->tmpl->priority;
+	memcpy(proc->path, img->tmpl->path, sizeof(proc->path));
+	proc->code = &img->code;
+	proc->bp = img->tmpl->bp;
+#ifdef MLQ_SCHED
+	proc->prio = img->tmpl->prio;
+#endif
+
+	/* Owned by the process, never the template's */
+	proc->pc = 0;
+	memset(proc->regs, 0, sizeof(proc->regs));
+	proc->krnl = NULL;
+#ifdef MM_PAGING
+	proc->page_table = NULL;
+	proc->mm = NULL;
+#else
+	/* The legacy allocator fills it in from the first alloc on */
+	proc->page_table = calloc(1, sizeof(struct page_table_t));
+	if (proc->page_table == NULL) {
+		ld_image_put(proc);
+		free(proc);
+		return NULL;
+	}
+#endif
+
+	return proc;
+}
+
+/*
+ * ld_image_preload - parse a program before any process runs it
+ * The image then stays for the life of the simulator, and of the batch
+ * instances it forks.
+ */
+int ld_image_preload(const char * path) {
+	struct ld_image * img;
+
+	pthread_mutex_lock(&ld_image_lock);
+	img = ld_image_lookup(path);
+	if (img != NULL)
+		img->ref++;
+	pthread_mutex_unlock(&ld_image_lock);
+
+	return img != NULL ? 0 : -1;
+}
+
+static void ld_image_free(struct ld_image * img) {
+	cpu_decode_free(&img->code);
+	free(img->code.text);
+	free(img->tmpl->page_table);
+	free(img->tmpl);
+	free(img->path);
+	free(img);
+}
+
+/* The process is done with its program, after ld_image_flush() the last
+ * one frees the image */
+void ld_image_put(struct pcb_t * proc) {
+	struct ld_image * img = ld_image_of(proc->code);
+	struct ld_image ** link;
+
+#ifndef MM_PAGING
+	/* Along with the page table ld_image_get() gave the process */
+	if (proc->page_table != NULL) {
+		int i;
+
+		for (i = 0; i < proc->page_table->size; i++)
+			free(proc->page_table->table[i].next_lv);
+		free(proc->page_table);
+		proc->page_table = NULL;
+	}
+#endif
+
+	pthread_mutex_lock(&ld_image_lock);
+	if (--img->ref > 0 || !ld_image_flushed) {
+		pthread_mutex_unlock(&ld_image_lock);
+		return;
+	}
+
+	for (link = &ld_images[ld_image_hash(img->path)]; *link != img;
+	     link = &(*link)->next)
+		;
+	*link = img->next;
+	pthread_mutex_unlock(&ld_image_lock);
+
+	ld_image_free(img);
+}
+
+/*
+ * ld_image_flush - no process is loaded any more
+ * Frees the images no process runs, the others go with their last
+ * process.
+ */
+void ld_image_flush(void) {
+	struct ld_image * img, ** link;
+	int b;
+
+	pthread_mutex_lock(&ld_image_lock);
+	ld_image_flushed = 1;
+	for (b = 0; b < LD_IMAGE_BUCKETS; b++) {
+		link = &ld_images[b];
+		while ((img = *link) != NULL) {
+			if (img->ref > 0) {
+				link = &img->next;
+				continue;
+			}
+			*link = img->next;
+			ld_image_free(img);
+		}
+	}
+	pthread_mutex_unlock(&ld_image_lock);
+}
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * PAGING based Memory Management
+ * Physical frame allocator mm/mm-buddy.c
+ *
+ * The frames of a memphy device are handed out by a binary buddy
+ * allocator: blocks of 2^order contiguous frames, split on allocation and
+ * merged with their buddy on release. Single frames go through a small
+ * per-CPU cache refilled from (and drained to) the buddy lists in batches,
+ * so the common fault path does not take the allocator lock. A CPU that
+ * finds both its cache and the buddy lists empty drains the caches of the
+ * other CPUs before giving up.
+ */
+
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#define FRAME_MAX_ORDER 10       /* 1024 frames per block at most */
+#define FRAME_PCP_BATCH 16       /* frames moved per refill/drain at most */
+#define FRAME_PCP_HIGH  (2 * FRAME_PCP_BATCH)
+
+struct frame_pcp {
+  pthread_mutex_t lock;          /* uncontended but for a drain */
+  int count;
+  addr_t fpn[FRAME_PCP_HIGH];
+};
+
+struct memphy_frames {
+  pthread_mutex_t lock;
+  int nframes;
+  int8_t *order;                 /* order of the free block heading at a frame, -1 otherwise */
+  int *next;                     /* free list links, by frame index */
+  int *prev;
+  int head[FRAME_MAX_ORDER + 1];
+  int nr_free;                   /* free frames, per-CPU caches included (atomic) */
+  int ncpu;
+  int batch;                     /* frames moved per refill/drain */
+  struct frame_pcp *pcp;
+};
+
+/* CPU whose frame cache the calling thread uses, -1 if none */
+static __thread int frame_cpu = -1;
+
+static void buddy_link(struct memphy_frames *fa, int f, int o)
+{
+  fa->order[f] = o;
+  fa->prev[f] = -1;
+  fa->next[f] = fa->head[o];
+  if (fa->head[o] >= 0)
+    fa->prev[fa->head[o]] = f;
+  fa->head[o] = f;
+}
+
+static void buddy_unlink(struct memphy_frames *fa, int f)
+{
+  int o = fa->order[f];
+
+  if (fa->prev[f] >= 0)
+    fa->next[fa->prev[f]] = fa->next[f];
+  else
+    fa->head[o] = fa->next[f];
+  if (fa->next[f] >= 0)
+    fa->prev[fa->next[f]] = fa->prev[f];
+  fa->order[f] = -1;
+}
+
+/* Must be called with fa->lock held */
+static int buddy_alloc(struct memphy_frames *fa, int o)
+{
+  int k = o, f;
+
+  while (k <= FRAME_MAX_ORDER && fa->head[k] < 0)
+    k++;
+  if (k > FRAME_MAX_ORDER)
+    return -1;
+
+  f = fa->head[k];
+  buddy_unlink(fa, f);
+
+  /* Give the upper halves back until the block has the wanted size */
+  while (k > o)
+  {
+    k--;
+    buddy_link(fa, f + (1 << k), k);
+  }
+
+  __atomic_sub_fetch(&fa->nr_free, 1 << o, __ATOMIC_RELAXED);
+  return f;
+}
+
+/* Must be called with fa->lock held */
+static void buddy_free(struct memphy_frames *fa, int f, int o)
+{
+  __atomic_add_fetch(&fa->nr_free, 1 << o, __ATOMIC_RELAXED);
+
+  while (o < FRAME_MAX_ORDER)
+  {
+    int buddy = f ^ (1 << o);
+
+    if (buddy >= fa->nframes || fa->order[buddy] != o)
+      break;
+
+    buddy_unlink(fa, buddy);
+    if (buddy < f)
+      f = buddy;
+    o++;
+  }
+
+  buddy_link(fa, f, o);
+}
+
+/* Release a run of frames as the largest aligned blocks it holds */
+static void buddy_free_range(struct memphy_frames *fa, int f, int n)
+{
+  while (n > 0)
+  {
+    int o = 0;
+
+    while (o < FRAME_MAX_ORDER && !(f & (1 << o)) && (2 << o) <= n)
+      o++;
+
+    buddy_free(fa, f, o);
+    f += 1 << o;
+    n -= 1 << o;
+  }
+}
+
+/*
+ * MEMPHY_init_frames - put the frames of a memphy under the buddy allocator
+ * @mp   : memphy, already set up by init_memphy()
+ * @ncpu : number of simulated CPUs owning a frame cache
+ */
+int MEMPHY_init_frames(struct memphy_struct *mp, int ncpu)
+{
+  struct memphy_frames *fa = calloc(1, sizeof(struct memphy_frames));
+  struct framephy_struct *fp;
+  int i;
+
+  if (fa == NULL)
+    return -1;
+
+  fa->nframes = mp->maxsz / PAGING_PAGESZ;
+  fa->order = malloc(fa->nframes > 0 ? fa->nframes : 1);
+  fa->next = malloc((fa->nframes > 0 ? fa->nframes : 1) * sizeof(int));
+  fa->prev = malloc((fa->nframes > 0 ? fa->nframes : 1) * sizeof(int));
+  fa->ncpu = ncpu > 0 ? ncpu : 0;
+  fa->pcp = calloc(fa->ncpu > 0 ? fa->ncpu : 1, sizeof(struct frame_pcp));
+  if (fa->order == NULL || fa->next == NULL || fa->prev == NULL || fa->pcp == NULL)
+  {
+    free(fa->order);
+    free(fa->next);
+    free(fa->prev);
+    free(fa->pcp);
+    free(fa);
+    return -1;
+  }
+
+  pthread_mutex_init(&fa->lock, NULL);
+  for (i = 0; i <= FRAME_MAX_ORDER; i++)
+    fa->head[i] = -1;
+  for (i = 0; i < fa->nframes; i++)
+    fa->order[i] = -1;
+  for (i = 0; i < fa->ncpu; i++)
+    pthread_mutex_init(&fa->pcp[i].lock, NULL);
+
+  /* A small memory must not end up parked in the caches */
+  fa->batch = FRAME_PCP_BATCH;
+  if (fa->ncpu > 0 && fa->batch > fa->nframes / (4 * fa->ncpu))
+    fa->batch = fa->nframes / (4 * fa->ncpu);
+  if (fa->batch < 1)
+    fa->batch = 1;
+
+  buddy_free_range(fa, 0, fa->nframes);
+
+  /* The frame list built by init_memphy() is superseded */
+  while ((fp = mp->free_fp_list) != NULL)
+  {
+    mp->free_fp_list = fp->fp_next;
+    free(fp);
+  }
+
+  mp->frames = fa;
+  return 0;
+}
+
+/*
+ * MEMPHY_bind_cpu - use the frame cache of a CPU from the calling thread
+ * @cpuid : CPU index, a negative value detaches the thread
+ */
+void MEMPHY_bind_cpu(int cpuid)
+{
+  frame_cpu = cpuid;
+}
+
+static struct frame_pcp *frame_this_pcp(struct memphy_frames *fa)
+{
+  if (frame_cpu < 0 || frame_cpu >= fa->ncpu)
+    return NULL;
+
+  return &fa->pcp[frame_cpu];
+}
+
+/*
+ * MEMPHY_alloc_frames - get 2^order contiguous frames
+ * @mp    : memphy
+ * @order : block order
+ * @fpn   : returned first frame number
+ */
+int MEMPHY_alloc_frames(struct memphy_struct *mp, int order, addr_t *fpn)
+{
+  struct memphy_frames *fa = mp->frames;
+  int f;
+
+  if (order < 0 || order > FRAME_MAX_ORDER)
+    return -1;
+
+  pthread_mutex_lock(&fa->lock);
+  f = buddy_alloc(fa, order);
+  pthread_mutex_unlock(&fa->lock);
+
+  if (f < 0)
+    return -1;
+
+  *fpn = f;
+  return 0;
+}
+
+/*
+ * MEMPHY_alloc_contig - get n contiguous frames
+ * @mp  : memphy
+ * @n   : number of frames
+ * @fpn : returned first frame number
+ */
+int MEMPHY_alloc_contig(struct memphy_struct *mp, int n, addr_t *fpn)
+{
+  struct memphy_frames *fa = mp->frames;
+  int o = 0, f;
+
+  if (n <= 0)
+    return -1;
+
+  while ((1 << o) < n)
+    o++;
+  if (o > FRAME_MAX_ORDER)
+    return -1;
+
+  pthread_mutex_lock(&fa->lock);
+  f = buddy_alloc(fa, o);
+  if (f >= 0)
+    buddy_free_range(fa, f + n, (1 << o) - n); /* trim the tail */
+  pthread_mutex_unlock(&fa->lock);
+
+  if (f < 0)
+    return -1;
+
+  *fpn = f;
+  return 0;
+}
+
+/*
+ * MEMPHY_free_frames - release n contiguous frames
+ * @mp  : memphy
+ * @fpn : first frame number
+ * @n   : number of frames
+ */
+int MEMPHY_free_frames(struct memphy_struct *mp, addr_t fpn, int n)
+{
+  struct memphy_frames *fa = mp->frames;
+
+  if (n <= 0 || fpn + n > (addr_t)fa->nframes)
+    return -1;
+
+  pthread_mutex_lock(&fa->lock);
+  buddy_free_range(fa, fpn, n);
+  pthread_mutex_unlock(&fa->lock);
+
+  return 0;
+}
+
+/* Refill an empty cache with a batch under one lock round trip,
+ * pcp->lock held */
+static void frame_pcp_refill(struct memphy_frames *fa, struct frame_pcp *pcp)
+{
+  pthread_mutex_lock(&fa->lock);
+  while (pcp->count < fa->batch)
+  {
+    int f = buddy_alloc(fa, 0);
+
+    if (f < 0)
+      break;
+    pcp->fpn[pcp->count++] = f;
+  }
+  /* Cached frames still count as free */
+  __atomic_add_fetch(&fa->nr_free, pcp->count, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&fa->lock);
+}
+
+/* Give the n oldest frames of a cache back to the buddy lists,
+ * pcp->lock held */
+static void frame_pcp_drain(struct memphy_frames *fa, struct frame_pcp *pcp, int n)
+{
+  int i;
+
+  pthread_mutex_lock(&fa->lock);
+  __atomic_sub_fetch(&fa->nr_free, n, __ATOMIC_RELAXED);
+  for (i = 0; i < n; i++)
+    buddy_free(fa, pcp->fpn[i], 0);
+  pthread_mutex_unlock(&fa->lock);
+
+  for (i = n; i < pcp->count; i++)
+    pcp->fpn[i - n] = pcp->fpn[i];
+  pcp->count -= n;
+}
+
+/* Pull back the frames parked in the caches of the other CPUs */
+static void frame_drain_others(struct memphy_frames *fa, struct frame_pcp *self)
+{
+  int c;
+
+  for (c = 0; c < fa->ncpu; c++)
+  {
+    struct frame_pcp *pcp = &fa->pcp[c];
+
+    if (pcp == self)
+      continue;
+
+    pthread_mutex_lock(&pcp->lock);
+    if (pcp->count > 0)
+      frame_pcp_drain(fa, pcp, pcp->count);
+    pthread_mutex_unlock(&pcp->lock);
+  }
+}
+
+/*
+ * MEMPHY_alloc_frame - get one frame, from the CPU cache when possible
+ * @mp  : memphy
+ * @fpn : returned frame number
+ */
+int MEMPHY_alloc_frame(struct memphy_struct *mp, addr_t *fpn)
+{
+  struct memphy_frames *fa = mp->frames;
+  struct frame_pcp *pcp = frame_this_pcp(fa);
+
+  if (pcp == NULL)
+  {
+    if (MEMPHY_alloc_frames(mp, 0, fpn) == 0)
+      return 0;
+
+    frame_drain_others(fa, NULL);
+    return MEMPHY_alloc_frames(mp, 0, fpn);
+  }
+
+  pthread_mutex_lock(&pcp->lock);
+  if (pcp->count == 0)
+    frame_pcp_refill(fa, pcp);
+
+  if (pcp->count == 0)
+  {
+    /* Drop our cache lock first, two CPUs may be draining each other */
+    pthread_mutex_unlock(&pcp->lock);
+    frame_drain_others(fa, pcp);
+    pthread_mutex_lock(&pcp->lock);
+    frame_pcp_refill(fa, pcp);
+
+    if (pcp->count == 0)
+    {
+      pthread_mutex_unlock(&pcp->lock);
+      return -1;
+    }
+  }
+
+  *fpn = pcp->fpn[--pcp->count];
+  __atomic_sub_fetch(&fa->nr_free, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&pcp->lock);
+
+  return 0;
+}
+
+/*
+ * MEMPHY_free_frame - release one frame, to the CPU cache when possible
+ * @mp  : memphy
+ * @fpn : frame number
+ */
+int MEMPHY_free_frame(struct memphy_struct *mp, addr_t fpn)
+{
+  struct memphy_frames *fa = mp->frames;
+  struct frame_pcp *pcp = frame_this_pcp(fa);
+
+  if (fpn >= (addr_t)fa->nframes)
+    return -1;
+
+  if (pcp == NULL)
+    return MEMPHY_free_frames(mp, fpn, 1);
+
+  pthread_mutex_lock(&pcp->lock);
+  pcp->fpn[pcp->count++] = fpn;
+  __atomic_add_fetch(&fa->nr_free, 1, __ATOMIC_RELAXED);
+
+  /* Drain the oldest frames back so the buddies can merge again */
+  if (pcp->count >= 2 * fa->batch)
+    frame_pcp_drain(fa, pcp, fa->batch);
+  pthread_mutex_unlock(&pcp->lock);
+
+  return 0;
+}
+
+/*
+ * MEMPHY_nr_free_frames - number of free frames of a memphy
+ * @mp : memphy
+ */
+int MEMPHY_nr_free_frames(struct memphy_struct *mp)
+{
+  return __atomic_load_n(&mp->frames->nr_free, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * PAGING based Memory Management
+ * Free region allocator mm/mm-freerg.c
+ *
+ * The free regions of a vm area are kept twice:
+ *   - in a treap ordered by start address, so a freed region finds the
+ *     neighbours it merges with in O(log n),
+ *   - in segregated size classes (one list per power of two) with a
+ *     bitmap of the non-empty classes, so an allocation picks a fitting
+ *     region without walking the free list.
+ * Adjacent free regions are always merged, the region count only grows
+ * with real fragmentation of the address space.
+ */
+
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+#define FREERG_NCLASS 64
+
+struct freerg_node {
+  addr_t start;
+  addr_t end;
+  uint32_t prio;
+  struct freerg_node *left;      /* treap, by start address */
+  struct freerg_node *right;
+  struct freerg_node *cnext;     /* size class list */
+  struct freerg_node *cprev;
+};
+
+struct vm_freerg_area {
+  struct freerg_node *root;
+  struct freerg_node *class[FREERG_NCLASS];
+  uint64_t classmap;             /* bit k set: class[k] not empty */
+  uint32_t seed;
+  int nr;
+  struct mm_pool *pool;          /* freerg_node storage */
+};
+
+static int freerg_class(addr_t size)
+{
+  return 63 - __builtin_clzll((unsigned long long)size);
+}
+
+static void freerg_class_link(struct vm_freerg_area *fa, struct freerg_node *n)
+{
+  int k = freerg_class(n->end - n->start);
+
+  n->cprev = NULL;
+  n->cnext = fa->class[k];
+  if (fa->class[k] != NULL)
+    fa->class[k]->cprev = n;
+  fa->class[k] = n;
+  fa->classmap |= 1ULL << k;
+}
+
+/* Must be called before the bounds of n change */
+static void freerg_class_unlink(struct vm_freerg_area *fa, struct freerg_node *n)
+{
+  int k = freerg_class(n->end - n->start);
+
+  if (n->cprev != NULL)
+    n->cprev->cnext = n->cnext;
+  else
+    fa->class[k] = n->cnext;
+  if (n->cnext != NULL)
+    n->cnext->cprev = n->cprev;
+  if (fa->class[k] == NULL)
+    fa->classmap &= ~(1ULL << k);
+}
+
+/* Split t into the nodes starting before key and the others */
+static void treap_split(struct freerg_node *t, addr_t key,
+                        struct freerg_node **l, struct freerg_node **r)
+{
+  if (t == NULL)
+  {
+    *l = *r = NULL;
+  }
+  else if (t->start < key)
+  {
+    treap_split(t->right, key, &t->right, r);
+    *l = t;
+  }
+  else
+  {
+    treap_split(t->left, key, l, &t->left);
+    *r = t;
+  }
+}
+
+/* Every node of l starts before every node of r */
+static struct freerg_node *treap_merge(struct freerg_node *l, struct freerg_node *r)
+{
+  if (l == NULL)
+    return r;
+  if (r == NULL)
+    return l;
+
+  if (l->prio > r->prio)
+  {
+    l->right = treap_merge(l->right, r);
+    return l;
+  }
+
+  r->left = treap_merge(l, r->left);
+  return r;
+}
+
+static void treap_insert(struct vm_freerg_area *fa, struct freerg_node *n)
+{
+  struct freerg_node *l, *r;
+
+  /* xorshift, the priorities only need to look random */
+  fa->seed ^= fa->seed << 13;
+  fa->seed ^= fa->seed >> 17;
+  fa->seed ^= fa->seed << 5;
+  n->prio = fa->seed;
+  n->left = n->right = NULL;
+
+  treap_split(fa->root, n->start, &l, &r);
+  fa->root = treap_merge(treap_merge(l, n), r);
+}
+
+static void treap_erase(struct vm_freerg_area *fa, struct freerg_node *n)
+{
+  struct freerg_node *l, *m, *r;
+
+  treap_split(fa->root, n->start, &l, &m);
+  treap_split(m, n->start + 1, &m, &r);
+  fa->root = treap_merge(l, r);
+}
+
+/* Last region starting before addr */
+static struct freerg_node *treap_prev(struct freerg_node *t, addr_t addr)
+{
+  struct freerg_node *best = NULL;
+
+  while (t != NULL)
+  {
+    if (t->start < addr)
+    {
+      best = t;
+      t = t->right;
+    }
+    else
+      t = t->left;
+  }
+
+  return best;
+}
+
+/* First region starting at or after addr */
+static struct freerg_node *treap_next(struct freerg_node *t, addr_t addr)
+{
+  struct freerg_node *best = NULL;
+
+  while (t != NULL)
+  {
+    if (t->start >= addr)
+    {
+      best = t;
+      t = t->left;
+    }
+    else
+      t = t->right;
+  }
+
+  return best;
+}
+
+static void freerg_drop(struct vm_freerg_area *fa, struct freerg_node *n)
+{
+  freerg_class_unlink(fa, n);
+  treap_erase(fa, n);
+  mm_pool_free(fa->pool, n);
+  fa->nr--;
+}
+
+/*
+ * vm_freerg_put - give a region back to the free regions of a vm area
+ * @vma   : vm area
+ * @start : region start
+ * @end   : region end (excluded)
+ * The region is merged with the free regions it touches. A region
+ * overlapping one already free is refused.
+ */
+int vm_freerg_put(struct vm_area_struct *vma, addr_t start, addr_t end)
+{
+  struct vm_freerg_area *fa = vma->vm_freerg;
+  struct freerg_node *prev, *next, *n;
+
+  if (start >= end)
+    return -1;
+
+  if (fa == NULL)
+  {
+    fa = calloc(1, sizeof(struct vm_freerg_area));
+    if (fa == NULL)
+      return -1;
+    fa->pool = mm_pool_create(sizeof(struct freerg_node), 32);
+    if (fa->pool == NULL)
+    {
+      free(fa);
+      return -1;
+    }
+    fa->seed = 2463534242u;
+    vma->vm_freerg = fa;
+  }
+
+  prev = treap_prev(fa->root, start);
+  next = treap_next(fa->root, start);
+
+  if ((prev != NULL && prev->end > start) || (next != NULL && next->start < end))
+    return -1;
+
+  if (prev != NULL && prev->end == start)
+  {
+    /* Grow the left neighbour, its start (the treap key) is kept */
+    freerg_class_unlink(fa, prev);
+    prev->end = end;
+    if (next != NULL && next->start == end)
+    {
+      prev->end = next->end;
+      freerg_drop(fa, next);
+    }
+    freerg_class_link(fa, prev);
+    return 0;
+  }
+
+  if (next != NULL && next->start == end)
+  {
+    /* Grow the right neighbour downwards, it keeps its treap position
+     * as nothing lies between prev and it */
+    freerg_class_unlink(fa, next);
+    next->start = start;
+    freerg_class_link(fa, next);
+    return 0;
+  }
+
+  n = mm_pool_alloc(fa->pool);
+  if (n == NULL)
+    return -1;
+  n->start = start;
+  n->end = end;
+  treap_insert(fa, n);
+  freerg_class_link(fa, n);
+  fa->nr++;
+
+  return 0;
+}
+
+/*
+ * vm_freerg_get - carve a region out of the free regions of a vm area
+ * @vma   : vm area
+ * @size  : wanted size
+ * @newrg : returned region
+ * Any region of a size class above the one of size fits and is taken in
+ * O(1). Only when none is left the class of size itself is searched.
+ */
+int vm_freerg_get(struct vm_area_struct *vma, addr_t size, struct vm_rg_struct *newrg)
+{
+  struct vm_freerg_area *fa = vma->vm_freerg;
+  struct freerg_node *n = NULL;
+  uint64_t fit;
+  int k, first;
+
+  if (fa == NULL || fa->classmap == 0 || size == 0)
+    return -1;
+
+  /* Every region of a class above the one of size fits, so does every
+   * region of its own class when size is a power of two */
+  k = freerg_class(size);
+  first = (size & (size - 1)) == 0 ? k : k + 1;
+  fit = first < FREERG_NCLASS ? fa->classmap >> first : 0;
+
+  if (fit != 0)
+    n = fa->class[first + __builtin_ctzll(fit)];
+  else
+    for (n = fa->class[k]; n != NULL; n = n->cnext)
+      if (n->end - n->start >= size)
+        break;
+
+  if (n == NULL)
+    return -1;
+
+  newrg->rg_start = n->start;
+  newrg->rg_end = n->start + size;
+  newrg->rg_next = NULL;
+
+  if (n->end - n->start == size)
+  {
+    freerg_drop(fa, n);
+    return 0;
+  }
+
+  /* Keep the tail, the start moves up without passing the next region */
+  freerg_class_unlink(fa, n);
+  n->start += size;
+  freerg_class_link(fa, n);
+
+  return 0;
+}
+
+/*
+ * vm_freerg_destroy - release the free region bookkeeping of a vm area
+ * @vma : vm area
+ */
+void vm_freerg_destroy(struct vm_area_struct *vma)
+{
+  if (vma->vm_freerg == NULL)
+    return;
+
+  /* The nodes go away with their pool */
+  mm_pool_destroy(vma->vm_freerg->pool);
+  free(vma->vm_freerg);
+  vma->vm_freerg = NULL;
+}
+
+static void treap_print(struct freerg_node *t)
+{
+  if (t == NULL)
+    return;
+
+  treap_print(t->left);
+  printf("rg[" FORMAT_ADDR "->"  FORMAT_ADDR "]\n", t->start, t->end);
+  treap_print(t->right);
+}
+
+/*
+ * vm_freerg_print - print the free regions of a vm area by address
+ * @vma : vm area
+ */
+int vm_freerg_print(struct vm_area_struct *vma)
+{
+  printf("print_list_freerg:\n");
+  if (vma->vm_freerg != NULL)
+    treap_print(vma->vm_freerg->root);
+  printf("\n");
+
+  return 0;
+}
@@ -0,0 +1,716 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * PAGING based Memory Management
+ * Page replacement policies mm/mm-pgrepl.c
+ *
+ * Every address space tracks its resident pages through a policy:
+ *   fifo  - ring buffer, evict the oldest mapped page
+ *   clock - second chance on the PTE accessed bit
+ *   lru   - aging counters fed by the accessed bit (LRU approximation)
+ *   arc   - Adaptive Replacement Cache with ghost lists
+ * The policy is picked by name (PGREPL option of the config file) and
+ * applies to the address spaces created after the selection.
+ */
+
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(MM64)
+
+struct pgrepl_ops {
+  const char *name;
+  int (*init)(struct pgrepl *pr);
+  void (*destroy)(struct pgrepl *pr);
+  int (*insert)(struct pgrepl *pr, addr_t pgn);
+  void (*touch)(struct pgrepl *pr, addr_t pgn);
+  int (*evict)(struct pgrepl *pr, addr_t *pgn);
+  int (*putback)(struct pgrepl *pr, addr_t pgn);
+  int touch_unlocked;        /* touch only sets the PTE accessed bit */
+};
+
+struct pgrepl {
+  const struct pgrepl_ops *ops;
+  struct mm_struct *mm;
+  void *priv;
+  pthread_mutex_t lock;      /* faults and the reclaim daemon share it */
+};
+
+/* A page is worth keeping track of only while it is mapped to MEMRAM */
+static int pgrepl_online(struct mm_struct *mm, addr_t pgn)
+{
+  uint32_t pte = mm_get_pte(mm, pgn);
+
+  return PAGING_PAGE_PRESENT(pte) && !(pte & PAGING_PTE_SWAPPED_MASK);
+}
+
+/*
+ * Ring buffer shared by fifo, clock and lru
+ *
+ * A page unmapped and mapped again before the hand reaches its entry gets
+ * a second one. Every insert stamps the page with a new generation, kept
+ * in its PTE and in the entry: only the entry of the current generation
+ * is live, the older ones are dropped when the hand gets to them.
+ */
+struct pgrepl_slot {
+  addr_t pgn;
+  uint32_t gen;
+  uint8_t age;
+};
+
+struct pgrepl_ring {
+  struct pgrepl_slot *slot;
+  unsigned long cap;     /* power of two */
+  unsigned long head;
+  unsigned long count;
+  uint32_t gen;          /* of the last insert */
+};
+
+#define PGREPL_RING_MINCAP 64
+
+static int ring_init(struct pgrepl *pr)
+{
+  struct pgrepl_ring *rb = calloc(1, sizeof(struct pgrepl_ring));
+
+  if (rb == NULL)
+    return -1;
+
+  rb->cap = PGREPL_RING_MINCAP;
+  rb->slot = malloc(rb->cap * sizeof(struct pgrepl_slot));
+  if (rb->slot == NULL)
+  {
+    free(rb);
+    return -1;
+  }
+
+  pr->priv = rb;
+  return 0;
+}
+
+static void ring_destroy(struct pgrepl *pr)
+{
+  struct pgrepl_ring *rb = pr->priv;
+
+  free(rb->slot);
+  free(rb);
+}
+
+static int ring_push(struct pgrepl_ring *rb, addr_t pgn, uint32_t gen, uint8_t age)
+{
+  if (rb->count == rb->cap)
+  {
+    /* Grow and unwrap so that head restarts at slot 0 */
+    struct pgrepl_slot *nslot = malloc(2 * rb->cap * sizeof(struct pgrepl_slot));
+    unsigned long i;
+
+    if (nslot == NULL)
+      return -1;
+
+    for (i = 0; i < rb->count; i++)
+      nslot[i] = rb->slot[(rb->head + i) & (rb->cap - 1)];
+
+    free(rb->slot);
+    rb->slot = nslot;
+    rb->cap *= 2;
+    rb->head = 0;
+  }
+
+  rb->slot[(rb->head + rb->count) & (rb->cap - 1)].pgn = pgn;
+  rb->slot[(rb->head + rb->count) & (rb->cap - 1)].gen = gen;
+  rb->slot[(rb->head + rb->count) & (rb->cap - 1)].age = age;
+  rb->count++;
+
+  return 0;
+}
+
+/* Back in front of the others, first to be looked at again */
+static int ring_push_front(struct pgrepl_ring *rb, addr_t pgn, uint32_t gen,
+                           uint8_t age)
+{
+  if (ring_push(rb, pgn, gen, age) != 0)
+    return -1;
+
+  /* Move the new tail entry to the head */
+  rb->count--;
+  rb->head = (rb->head - 1) & (rb->cap - 1);
+  rb->slot[rb->head] = rb->slot[(rb->head + rb->count + 1) & (rb->cap - 1)];
+  rb->count++;
+
+  return 0;
+}
+
+static int ring_pop(struct pgrepl_ring *rb, struct pgrepl_slot *out)
+{
+  if (rb->count == 0)
+    return -1;
+
+  *out = rb->slot[rb->head];
+  rb->head = (rb->head + 1) & (rb->cap - 1);
+  rb->count--;
+
+  return 0;
+}
+
+/* The entry is the current one of a mapped page */
+static int ring_live(struct pgrepl *pr, struct pgrepl_slot *s)
+{
+  return pgrepl_online(pr->mm, s->pgn) && pte_get_gen(pr->mm, s->pgn) == s->gen;
+}
+
+static int ring_insert(struct pgrepl *pr, addr_t pgn)
+{
+  struct pgrepl_ring *rb = pr->priv;
+  uint32_t gen = ++rb->gen & 0xffffff;
+
+  /* A newly mapped page starts as just referenced */
+  pte_set_accessed(pr->mm, pgn);
+  pte_set_gen(pr->mm, pgn, gen);
+
+  return ring_push(rb, pgn, gen, 0x80);
+}
+
+static void ring_touch(struct pgrepl *pr, addr_t pgn)
+{
+  pte_set_accessed(pr->mm, pgn);
+}
+
+/* An evicted page stays resident after all: it was the one to go, and
+ * still is, nothing referenced it meanwhile */
+static int ring_putback(struct pgrepl *pr, addr_t pgn)
+{
+  return ring_push_front(pr->priv, pgn, pte_get_gen(pr->mm, pgn), 0);
+}
+
+/* FIFO: the oldest mapped page goes first */
+static int fifo_evict(struct pgrepl *pr, addr_t *pgn)
+{
+  struct pgrepl_slot s;
+
+  while (ring_pop(pr->priv, &s) == 0)
+  {
+    if (!ring_live(pr, &s))
+      continue; /* stale entry */
+
+    *pgn = s.pgn;
+    return 0;
+  }
+
+  return -1;
+}
+
+/* CLOCK: a referenced page gets a second chance at the tail */
+static int clock_evict(struct pgrepl *pr, addr_t *pgn)
+{
+  struct pgrepl_ring *rb = pr->priv;
+  struct pgrepl_slot s;
+
+  /* Every pass clears the bits, so one full turn is enough */
+  while (ring_pop(rb, &s) == 0)
+  {
+    if (!ring_live(pr, &s))
+      continue;
+
+    if (pte_test_clear_accessed(pr->mm, s.pgn))
+    {
+      ring_push(rb, s.pgn, s.gen, 0);
+      continue;
+    }
+
+    *pgn = s.pgn;
+    return 0;
+  }
+
+  return -1;
+}
+
+/*
+ * LRU approximation: every time the hand passes a page its 8 bit age is
+ * shifted right and the accessed bit enters at the top, a page is evicted
+ * once it has not been referenced for the whole history window.
+ */
+static int lru_evict(struct pgrepl *pr, addr_t *pgn)
+{
+  struct pgrepl_ring *rb = pr->priv;
+  struct pgrepl_slot s;
+
+  while (ring_pop(rb, &s) == 0)
+  {
+    if (!ring_live(pr, &s))
+      continue;
+
+    s.age >>= 1;
+    if (pte_test_clear_accessed(pr->mm, s.pgn))
+      s.age |= 0x80;
+
+    if (s.age != 0)
+    {
+      ring_push(rb, s.pgn, s.gen, s.age);
+      continue;
+    }
+
+    *pgn = s.pgn;
+    return 0;
+  }
+
+  return -1;
+}
+
+/*
+ * ARC: T1/T2 hold the resident pages seen once/several times, B1/B2 the
+ * ghosts of the pages recently evicted from them. A fault on a ghost moves
+ * the target size p of T1 toward the list that would have kept the page.
+ * The cache size c follows the number of resident pages of the address
+ * space, frames being shared with the other processes.
+ */
+enum { ARC_T1, ARC_T2, ARC_B1, ARC_B2, ARC_NLIST };
+
+struct arc_node {
+  addr_t pgn;
+  int list;
+  struct arc_node *prev;     /* toward MRU */
+  struct arc_node *next;     /* toward LRU */
+  struct arc_node *hnext;
+};
+
+struct arc_list {
+  struct arc_node *mru;
+  struct arc_node *lru;
+  unsigned long len;
+};
+
+struct arc_state {
+  struct arc_list l[ARC_NLIST];
+  unsigned long p;
+  struct arc_node **hash;
+  unsigned long nbucket;     /* power of two */
+  unsigned long nnode;
+  struct mm_pool *pool;      /* arc_node storage */
+};
+
+#define ARC_MINBUCKET 64
+
+static unsigned long arc_hash(struct arc_state *st, addr_t pgn)
+{
+  return (unsigned long)((pgn * 0x9E3779B97F4A7C15ULL) >> 17) & (st->nbucket - 1);
+}
+
+static struct arc_node *arc_find(struct arc_state *st, addr_t pgn)
+{
+  struct arc_node *n = st->hash[arc_hash(st, pgn)];
+
+  while (n != NULL && n->pgn != pgn)
+    n = n->hnext;
+
+  return n;
+}
+
+static void arc_hash_add(struct arc_state *st, struct arc_node *n)
+{
+  unsigned long b;
+
+  if (st->nnode >= st->nbucket)
+  {
+    /* Keep the chains short, rehash into twice the buckets */
+    struct arc_node **nhash = calloc(2 * st->nbucket, sizeof(struct arc_node *));
+
+    if (nhash != NULL)
+    {
+      struct arc_node **ohash = st->hash;
+      unsigned long ob = st->nbucket;
+
+      st->hash = nhash;
+      st->nbucket *= 2;
+      for (b = 0; b < ob; b++)
+      {
+        while (ohash[b] != NULL)
+        {
+          struct arc_node *m = ohash[b];
+          unsigned long nb = arc_hash(st, m->pgn);
+
+          ohash[b] = m->hnext;
+          m->hnext = nhash[nb];
+          nhash[nb] = m;
+        }
+      }
+      free(ohash);
+    }
+  }
+
+  b = arc_hash(st, n->pgn);
+  n->hnext = st->hash[b];
+  st->hash[b] = n;
+  st->nnode++;
+}
+
+static void arc_hash_del(struct arc_state *st, struct arc_node *n)
+{
+  struct arc_node **pp = &st->hash[arc_hash(st, n->pgn)];
+
+  while (*pp != n)
+    pp = &(*pp)->hnext;
+  *pp = n->hnext;
+  st->nnode--;
+}
+
+static void arc_unlink(struct arc_state *st, struct arc_node *n)
+{
+  struct arc_list *l = &st->l[n->list];
+
+  if (n->prev) n->prev->next = n->next; else l->mru = n->next;
+  if (n->next) n->next->prev = n->prev; else l->lru = n->prev;
+  l->len--;
+}
+
+static void arc_push_mru(struct arc_state *st, struct arc_node *n, int list)
+{
+  struct arc_list *l = &st->l[list];
+
+  n->list = list;
+  n->prev = NULL;
+  n->next = l->mru;
+  if (l->mru) l->mru->prev = n; else l->lru = n;
+  l->mru = n;
+  l->len++;
+}
+
+static void arc_push_lru(struct arc_state *st, struct arc_node *n, int list)
+{
+  struct arc_list *l = &st->l[list];
+
+  n->list = list;
+  n->next = NULL;
+  n->prev = l->lru;
+  if (l->lru) l->lru->next = n; else l->mru = n;
+  l->lru = n;
+  l->len++;
+}
+
+static void arc_drop_lru(struct arc_state *st, int list)
+{
+  struct arc_node *n = st->l[list].lru;
+
+  if (n == NULL)
+    return;
+
+  arc_unlink(st, n);
+  arc_hash_del(st, n);
+  mm_pool_free(st->pool, n);
+}
+
+static int arc_init(struct pgrepl *pr)
+{
+  struct arc_state *st = calloc(1, sizeof(struct arc_state));
+
+  if (st == NULL)
+    return -1;
+
+  st->nbucket = ARC_MINBUCKET;
+  st->hash = calloc(st->nbucket, sizeof(struct arc_node *));
+  st->pool = mm_pool_create(sizeof(struct arc_node), ARC_MINBUCKET);
+  if (st->hash == NULL || st->pool == NULL)
+  {
+    free(st->hash);
+    mm_pool_destroy(st->pool);
+    free(st);
+    return -1;
+  }
+
+  pr->priv = st;
+  return 0;
+}
+
+static void arc_destroy(struct pgrepl *pr)
+{
+  struct arc_state *st = pr->priv;
+
+  /* Every node goes away with the pool */
+  mm_pool_destroy(st->pool);
+  free(st->hash);
+  free(st);
+}
+
+static int arc_insert(struct pgrepl *pr, addr_t pgn)
+{
+  struct arc_state *st = pr->priv;
+  struct arc_node *n = arc_find(st, pgn);
+  unsigned long c = st->l[ARC_T1].len + st->l[ARC_T2].len + 1;
+  unsigned long b1 = st->l[ARC_B1].len, b2 = st->l[ARC_B2].len;
+  unsigned long delta;
+
+  if (n != NULL)
+  {
+    switch (n->list)
+    {
+    case ARC_B1:
+      /* T1 was too small to keep this page, grow its target */
+      delta = (b1 >= b2) ? 1 : b2 / b1;
+      st->p = (st->p + delta < c) ? st->p + delta : c;
+      break;
+    case ARC_B2:
+      delta = (b2 >= b1) ? 1 : b1 / b2;
+      st->p = (st->p > delta) ? st->p - delta : 0;
+      break;
+    default:
+      /* Already resident, treat as a reference */
+      arc_unlink(st, n);
+      arc_push_mru(st, n, ARC_T2);
+      return 0;
+    }
+
+    arc_unlink(st, n);
+    arc_push_mru(st, n, ARC_T2);
+    return 0;
+  }
+
+  n = mm_pool_alloc(st->pool);
+  if (n == NULL)
+    return -1;
+
+  n->pgn = pgn;
+  arc_hash_add(st, n);
+  arc_push_mru(st, n, ARC_T1);
+
+  return 0;
+}
+
+static void arc_touch(struct pgrepl *pr, addr_t pgn)
+{
+  struct arc_state *st = pr->priv;
+  struct arc_node *n = arc_find(st, pgn);
+
+  if (n == NULL || (n->list != ARC_T1 && n->list != ARC_T2))
+    return;
+
+  /* A second reference promotes the page to the frequency list */
+  arc_unlink(st, n);
+  arc_push_mru(st, n, ARC_T2);
+}
+
+/*
+ * The victim arc_evict() moved to a ghost list stays resident: back to the
+ * LRU end of the list it came from. It is no ghost hit, p is unchanged
+ */
+static int arc_putback(struct pgrepl *pr, addr_t pgn)
+{
+  struct arc_state *st = pr->priv;
+  struct arc_node *n = arc_find(st, pgn);
+
+  if (n == NULL)
+    return arc_insert(pr, pgn);  /* the ghost was dropped already */
+
+  if (n->list == ARC_B1 || n->list == ARC_B2)
+  {
+    int from = n->list == ARC_B1 ? ARC_T1 : ARC_T2;
+
+    arc_unlink(st, n);
+    arc_push_lru(st, n, from);
+  }
+
+  return 0;
+}
+
+static int arc_evict(struct pgrepl *pr, addr_t *pgn)
+{
+  struct arc_state *st = pr->priv;
+  unsigned long c = st->l[ARC_T1].len + st->l[ARC_T2].len;
+
+  while (st->l[ARC_T1].len + st->l[ARC_T2].len > 0)
+  {
+    int from, ghost;
+    struct arc_node *n;
+
+    if (st->l[ARC_T1].len > 0 &&
+        (st->l[ARC_T1].len > st->p || st->l[ARC_T2].len == 0))
+    {
+      from = ARC_T1;
+      ghost = ARC_B1;
+    }
+    else
+    {
+      from = ARC_T2;
+      ghost = ARC_B2;
+    }
+
+    n = st->l[from].lru;
+    arc_unlink(st, n);
+
+    if (!pgrepl_online(pr->mm, n->pgn))
+    {
+      arc_hash_del(st, n);
+      mm_pool_free(st->pool, n);
+      continue;
+    }
+
+    *pgn = n->pgn;
+    arc_push_mru(st, n, ghost);
+
+    /* Bound the history: |T1|+|B1| <= c and the whole directory <= 2c */
+    while (st->l[ARC_B1].len > 0 &&
+           st->l[ARC_T1].len + st->l[ARC_B1].len > c)
+      arc_drop_lru(st, ARC_B1);
+    while (st->l[ARC_B2].len > 0 &&
+           st->l[ARC_T1].len + st->l[ARC_T2].len +
+           st->l[ARC_B1].len + st->l[ARC_B2].len > 2 * c)
+      arc_drop_lru(st, ARC_B2);
+
+    return 0;
+  }
+
+  return -1;
+}
+
+static const struct pgrepl_ops pgrepl_policies[] = {
+  { "fifo",  ring_init, ring_destroy, ring_insert, ring_touch, fifo_evict,  ring_putback, 1 },
+  { "clock", ring_init, ring_destroy, ring_insert, ring_touch, clock_evict, ring_putback, 1 },
+  { "lru",   ring_init, ring_destroy, ring_insert, ring_touch, lru_evict,   ring_putback, 1 },
+  { "arc",   arc_init,  arc_destroy,  arc_insert,  arc_touch,  arc_evict,   arc_putback,  0 },
+};
+
+#define PGREPL_NPOLICY (sizeof(pgrepl_policies) / sizeof(pgrepl_policies[0]))
+
+static const struct pgrepl_ops *pgrepl_default = &pgrepl_policies[0];
+
+/*
+ * pgrepl_select - choose the policy of the address spaces created next
+ * @name : fifo, clock, lru or arc
+ */
+int pgrepl_select(const char *name)
+{
+  unsigned long i;
+
+  for (i = 0; i < PGREPL_NPOLICY; i++)
+  {
+    if (strcmp(pgrepl_policies[i].name, name) == 0)
+    {
+      pgrepl_default = &pgrepl_policies[i];
+      return 0;
+    }
+  }
+
+  printf("[ERROR] Unknown page replacement policy %s\n", name);
+  return -1;
+}
+
+/*
+ * pgrepl_init - attach the selected replacement policy to an address space
+ * @mm : address space
+ */
+int pgrepl_init(struct mm_struct *mm)
+{
+  struct pgrepl *pr = malloc(sizeof(struct pgrepl));
+
+  if (pr == NULL)
+    return -1;
+
+  pr->ops = pgrepl_default;
+  pr->mm = mm;
+  pr->priv = NULL;
+  if (pr->ops->init(pr) != 0)
+  {
+    free(pr);
+    return -1;
+  }
+  pthread_mutex_init(&pr->lock, NULL);
+
+  mm->pgrepl = pr;
+  return 0;
+}
+
+void pgrepl_destroy(struct mm_struct *mm)
+{
+  if (mm->pgrepl == NULL)
+    return;
+
+  mm->pgrepl->ops->destroy(mm->pgrepl);
+  pthread_mutex_destroy(&mm->pgrepl->lock);
+  free(mm->pgrepl);
+  mm->pgrepl = NULL;
+}
+
+/*
+ * pgrepl_insert - a page became resident in MEMRAM
+ * @mm  : address space
+ * @pgn : page number
+ */
+int pgrepl_insert(struct mm_struct *mm, addr_t pgn)
+{
+  struct pgrepl *pr = mm->pgrepl;
+  int ret;
+
+  pthread_mutex_lock(&pr->lock);
+  ret = pr->ops->insert(pr, pgn);
+  pthread_mutex_unlock(&pr->lock);
+
+  return ret;
+}
+
+/*
+ * pgrepl_touch - a resident page was referenced
+ * @mm  : address space
+ * @pgn : page number
+ * Called on every access, TLB hits included: with the ring policies it
+ * is a single atomic on the PTE.
+ */
+void pgrepl_touch(struct mm_struct *mm, addr_t pgn)
+{
+  struct pgrepl *pr = mm->pgrepl;
+
+  if (pr->ops->touch_unlocked)
+  {
+    pr->ops->touch(pr, pgn);
+    return;
+  }
+
+  pthread_mutex_lock(&pr->lock);
+  pr->ops->touch(pr, pgn);
+  pthread_mutex_unlock(&pr->lock);
+}
+
+/*
+ * pgrepl_evict - pick a victim among the resident pages and forget it
+ * @mm  : address space
+ * @pgn : returned victim page number
+ */
+int pgrepl_evict(struct mm_struct *mm, addr_t *pgn)
+{
+  struct pgrepl *pr = mm->pgrepl;
+  int ret;
+
+  pthread_mutex_lock(&pr->lock);
+  ret = pr->ops->evict(pr, pgn);
+  pthread_mutex_unlock(&pr->lock);
+
+  return ret;
+}
+
+/*
+ * pgrepl_putback - a victim picked by pgrepl_evict() stays resident
+ * @mm  : address space
+ * @pgn : page number
+ * It is tracked again where it was, as the next one to go: not a new
+ * page and not a reference.
+ */
+int pgrepl_putback(struct mm_struct *mm, addr_t pgn)
+{
+  struct pgrepl *pr = mm->pgrepl;
+  int ret;
+
+  pthread_mutex_lock(&pr->lock);
+  ret = pr->ops->putback(pr, pgn);
+  pthread_mutex_unlock(&pr->lock);
+
+  return ret;
+}
+
+#endif  //def MM64
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * PAGING based Memory Management
+ * Object pools mm/mm-pool.c
+ *
+ * Fixed size kernel objects (frame list nodes, free region nodes,
+ * replacement policy nodes) are carved out of chunks holding many of them.
+ * A released object goes on the pool free list and is handed out again
+ * before a new chunk is taken. Nothing is given back to malloc until the
+ * pool is destroyed, which drops all the chunks at once whatever the
+ * objects still in use: the owner tears the pool down with its mm.
+ * A pool has no lock of its own, it is used under the lock of its owner.
+ */
+
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+#define MM_POOL_CHUNK_MIN 16
+
+struct mm_pool_chunk {
+  struct mm_pool_chunk *next;
+};
+
+struct mm_pool_obj {
+  struct mm_pool_obj *next;
+};
+
+struct mm_pool {
+  size_t objsz;
+  int perchunk;
+  struct mm_pool_obj *free;      /* released objects */
+  struct mm_pool_chunk *chunks;
+  char *bump;                    /* never used part of the newest chunk */
+  int nbump;
+  int nr_used;
+};
+
+/* Chunk header padded so the objects keep the malloc alignment */
+#define MM_POOL_HDRSZ \
+  ((sizeof(struct mm_pool_chunk) + sizeof(long double) - 1) & ~(sizeof(long double) - 1))
+
+/*
+ * mm_pool_create - create a pool of fixed size objects
+ * @objsz    : object size
+ * @perchunk : objects per chunk
+ */
+struct mm_pool *mm_pool_create(size_t objsz, int perchunk)
+{
+  struct mm_pool *pool = calloc(1, sizeof(struct mm_pool));
+
+  if (pool == NULL)
+    return NULL;
+
+  if (objsz < sizeof(struct mm_pool_obj))
+    objsz = sizeof(struct mm_pool_obj);
+
+  /* Round up so every object stays aligned in the chunk */
+  pool->objsz = (objsz + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  pool->perchunk = perchunk < MM_POOL_CHUNK_MIN ? MM_POOL_CHUNK_MIN : perchunk;
+
+  return pool;
+}
+
+/*
+ * mm_pool_alloc - get an object from a pool
+ * @pool : pool
+ * The object content is undefined.
+ */
+void *mm_pool_alloc(struct mm_pool *pool)
+{
+  void *obj;
+
+  if (pool->free != NULL)
+  {
+    obj = pool->free;
+    pool->free = pool->free->next;
+  }
+  else
+  {
+    if (pool->nbump == 0)
+    {
+      struct mm_pool_chunk *chunk = malloc(MM_POOL_HDRSZ + pool->perchunk * pool->objsz);
+
+      if (chunk == NULL)
+        return NULL;
+
+      chunk->next = pool->chunks;
+      pool->chunks = chunk;
+      pool->bump = (char *)chunk + MM_POOL_HDRSZ;
+      pool->nbump = pool->perchunk;
+    }
+
+    /* Objects of a fresh chunk are handed out in order, the free list
+     * only ever holds released ones */
+    obj = pool->bump;
+    pool->bump += pool->objsz;
+    pool->nbump--;
+  }
+
+  pool->nr_used++;
+  return obj;
+}
+
+/*
+ * mm_pool_free - give an object back to its pool
+ * @pool : pool
+ * @obj  : object from mm_pool_alloc() of the same pool
+ */
+void mm_pool_free(struct mm_pool *pool, void *obj)
+{
+  struct mm_pool_obj *o = obj;
+
+  if (obj == NULL)
+    return;
+
+  o->next = pool->free;
+  pool->free = o;
+  pool->nr_used--;
+}
+
+/*
+ * mm_pool_destroy - release a pool with all its objects
+ * @pool : pool
+ */
+void mm_pool_destroy(struct mm_pool *pool)
+{
+  struct mm_pool_chunk *chunk;
+
+  if (pool == NULL)
+    return;
+
+  while ((chunk = pool->chunks) != NULL)
+  {
+    pool->chunks = chunk->next;
+    free(chunk);
+  }
+
+  free(pool);
+}
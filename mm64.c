@@ -18,9 +18,34 @@
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #if defined(MM64)
 
+/* Address space IDs, 0 is never handed out so it can mean "no owner" */
+static uint32_t asid_next = 1;
+static pthread_mutex_t asid_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Locking of an address space, outermost first:
+ *   run_lock  - held by the CPU running the owner, the reclaim daemon only
+ *               evicts from an address space it can take it from
+ *   mmap_lock - rwlock over the vm areas, the free regions and the
+ *               symbol table: __alloc/__free write, __read/__write read
+ *   pte_lock  - striped mutexes serializing the updates of a PTE (fault,
+ *               swap out); a thread holds one stripe, plus at most the
+ *               stripe of a victim taken with trylock
+ *   policy and frame allocator locks are taken last.
+ * A TLB hit reads the frame with no lock at all: an evicted page cannot
+ * be in a TLB of the CPU running its owner, see mm_run_begin().
+ */
+#define MM_PTE_LOCK_STRIPES 16 /* power of two */
+#define SWAP_OUT_TRIES 4
+
+/* PTE stripe held by the fault in progress on this thread */
+static __thread pthread_mutex_t *pte_lock_held = NULL;
+
 /*
  * init_pte - Initialize PTE entry
  */
@@ -77,8 +102,6 @@ int get_pd_from_address(addr_t addr, addr_t* pgd, addr_t* p4d, addr_t* pud, addr
 	*pmd = (addr&PAGING64_ADDR_PMD_MASK)>>PAGING64_ADDR_PMD_LOBIT;
 	*pt = (addr&PAGING64_ADDR_PT_MASK)>>PAGING64_ADDR_PT_LOBIT;
 
-	/* TODO: implement the page direactories mapping */
-
 	return 0;
 }
 
@@ -98,6 +121,174 @@ int get_pd_from_pagenum(addr_t pgn, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_
                          pgd,p4d,pud,pmd,pt);
 }
 
+/*
+ * The page table is a 5 level radix tree PGD->P4D->PUD->PMD->PT rooted at
+ * mm->pgd. A directory entry holds the address of the next level table,
+ * a PT entry holds the PTE itself. Only the PGD is allocated by init_mm(),
+ * every lower level table is allocated the first time a page under it is
+ * touched, so a sparse address space pays only for its mapped ranges.
+ */
+#define PAGING64_PD_LEVELS 5
+
+/* Number of entries of the table at each level */
+static const addr_t pd_nentry[PAGING64_PD_LEVELS] = {
+  (PAGING64_ADDR_PGD_MASK >> PAGING64_ADDR_PGD_LOBIT) + 1,
+  (PAGING64_ADDR_P4D_MASK >> PAGING64_ADDR_P4D_LOBIT) + 1,
+  (PAGING64_ADDR_PUD_MASK >> PAGING64_ADDR_PUD_LOBIT) + 1,
+  (PAGING64_ADDR_PMD_MASK >> PAGING64_ADDR_PMD_LOBIT) + 1,
+  (PAGING64_ADDR_PT_MASK >> PAGING64_ADDR_PT_LOBIT) + 1,
+};
+
+/* Position of each level index inside a page number */
+static const int pd_pgnshift[PAGING64_PD_LEVELS] = {
+  PAGING64_ADDR_PGD_LOBIT - PAGING64_ADDR_PT_SHIFT,
+  PAGING64_ADDR_P4D_LOBIT - PAGING64_ADDR_PT_SHIFT,
+  PAGING64_ADDR_PUD_LOBIT - PAGING64_ADDR_PT_SHIFT,
+  PAGING64_ADDR_PMD_LOBIT - PAGING64_ADDR_PT_SHIFT,
+  PAGING64_ADDR_PT_LOBIT - PAGING64_ADDR_PT_SHIFT,
+};
+
+/*
+ * The PTE proper is 32 bit wide, the upper half of the PT slot holds
+ * software bits. The accessed bit is set by pg_getval/pg_setval and
+ * consumed by the page replacement policies, the generation tells the
+ * policy which of its entries for the page is the current one.
+ */
+#define PAGING64_PTE_ACCESSED_MASK ((addr_t)1 << 32)
+#define PAGING64_PTE_GEN_LOBIT 40
+#define PAGING64_PTE_GEN_MASK  ((addr_t)0xffffff << PAGING64_PTE_GEN_LOBIT)
+
+#define PD_TO_TABLE(ent) ((addr_t *)(uintptr_t)(ent))
+#define TABLE_TO_PD(tbl) ((addr_t)(uintptr_t)(tbl))
+
+/*
+ * pgd_walk - walk the page directories down to the PTE of a page
+ * @mm    : page table owner
+ * @pgn   : page number
+ * @alloc : allocate the missing directory tables on the way down
+ * @ret   : address of the PTE slot, NULL if it is not (or cannot be) mapped
+ */
+static addr_t *pgd_walk(struct mm_struct *mm, addr_t pgn, int alloc)
+{
+  addr_t idx[PAGING64_PD_LEVELS];
+  addr_t *tbl;
+  int lvl;
+
+  if (mm == NULL || mm->pgd == NULL)
+    return NULL;
+
+  get_pd_from_pagenum(pgn, &idx[0], &idx[1], &idx[2], &idx[3], &idx[4]);
+
+  tbl = mm->pgd;
+  for (lvl = 0; lvl < PAGING64_PD_LEVELS - 1; lvl++)
+  {
+    addr_t *ent = &tbl[idx[lvl]];
+
+    if (__atomic_load_n(ent, __ATOMIC_ACQUIRE) == 0)
+    {
+      if (!alloc)
+        return NULL;
+
+      /* First touch of this range, bring up the next level table. Faults
+       * under different PTE stripes may race here, the loser drops its copy */
+      addr_t *nxt = calloc(pd_nentry[lvl + 1], sizeof(addr_t));
+      addr_t expected = 0;
+
+      if (nxt == NULL)
+        return NULL;
+      if (!__atomic_compare_exchange_n(ent, &expected, TABLE_TO_PD(nxt), 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        free(nxt);
+    }
+
+    tbl = PD_TO_TABLE(__atomic_load_n(ent, __ATOMIC_ACQUIRE));
+  }
+
+  return &tbl[idx[PAGING64_PD_LEVELS - 1]];
+}
+
+static int pd_for_each_pte(addr_t *tbl, int lvl, addr_t pgnbase,
+                           int (*fn)(addr_t, addr_t *, void *), void *arg)
+{
+  addr_t i;
+  int ret;
+
+  for (i = 0; i < pd_nentry[lvl]; i++)
+  {
+    if (tbl[i] == 0)
+      continue;
+
+    addr_t pgn = pgnbase | (i << pd_pgnshift[lvl]);
+
+    if (lvl == PAGING64_PD_LEVELS - 1)
+      ret = fn(pgn, &tbl[i], arg);
+    else
+      ret = pd_for_each_pte(PD_TO_TABLE(tbl[i]), lvl + 1, pgn, fn, arg);
+
+    if (ret != 0)
+      return ret;
+  }
+
+  return 0;
+}
+
+/*
+ * pgd_for_each_pte - visit every non empty PTE of an address space
+ * @mm  : page table owner
+ * @fn  : visitor, called with the page number and its PTE slot,
+ *        a non zero return value stops the walk
+ * @arg : visitor private data
+ */
+int pgd_for_each_pte(struct mm_struct *mm,
+                     int (*fn)(addr_t pgn, addr_t *pte, void *arg), void *arg)
+{
+  if (mm == NULL || mm->pgd == NULL)
+    return -1;
+
+  return pd_for_each_pte(mm->pgd, 0, 0, fn, arg);
+}
+
+static void pd_free(addr_t *tbl, int lvl)
+{
+  addr_t i;
+
+  if (lvl < PAGING64_PD_LEVELS - 1)
+    for (i = 0; i < pd_nentry[lvl]; i++)
+      if (tbl[i] != 0)
+        pd_free(PD_TO_TABLE(tbl[i]), lvl + 1);
+
+  free(tbl);
+}
+
+/*
+ * free_pgd - release every page directory table of an address space
+ * @mm : page table owner
+ */
+int free_pgd(struct mm_struct *mm)
+{
+  if (mm == NULL || mm->pgd == NULL)
+    return -1;
+
+  pd_free(mm->pgd, 0);
+  mm->pgd = NULL;
+
+  return 0;
+}
+
+
+/*
+ * pte_sync_tlb - keep cached translations coherent with a PTE update
+ * A page that goes to swap or moves to another frame must not be served
+ * from a stale TLB entry, on this CPU or on any other one.
+ */
+static void pte_sync_tlb(struct mm_struct *mm, addr_t pgn, addr_t oldpte, addr_t newpte)
+{
+#ifdef CPU_TLB
+  if (PAGING_PAGE_PRESENT(oldpte) && !(oldpte & PAGING_PTE_SWAPPED_MASK) &&
+      oldpte != newpte)
+    tlb_invalidate_page(mm->asid, pgn);
+#endif
+}
 
 /*
  * pte_set_swap - Set PTE entry for swapped page
@@ -107,21 +298,23 @@ int get_pd_from_pagenum(addr_t pgn, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_
  */
 int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
 {
-  struct krnl_t *krnl = caller->krnl;
+  addr_t *pte = pgd_walk(caller->mm, pgn, 1);
+  addr_t oldpte, newpte;
 
-  // For simplified implementation: use direct pgd access
-  // Full multi-level would traverse PGD->P4D->PUD->PMD->PT
-  if (krnl == NULL || krnl->mm == NULL || krnl->mm->pgd == NULL) {
+  if (pte == NULL)
     return -1;
-  }
 
-  addr_t *pte = &krnl->mm->pgd[pgn];
-	
-  SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
-  SETBIT(*pte, PAGING_PTE_SWAPPED_MASK);
+  oldpte = newpte = __atomic_load_n(pte, __ATOMIC_RELAXED);
 
-  SETVAL(*pte, swptyp, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
-  SETVAL(*pte, swpoff, PAGING_PTE_SWPOFF_MASK, PAGING_PTE_SWPOFF_LOBIT);
+  SETBIT(newpte, PAGING_PTE_PRESENT_MASK);
+  SETBIT(newpte, PAGING_PTE_SWAPPED_MASK);
+
+  SETVAL(newpte, swptyp, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
+  SETVAL(newpte, swpoff, PAGING_PTE_SWPOFF_MASK, PAGING_PTE_SWPOFF_LOBIT);
+  newpte &= ~PAGING64_PTE_ACCESSED_MASK;
+
+  __atomic_store_n(pte, newpte, __ATOMIC_RELEASE);
+  pte_sync_tlb(caller->mm, pgn, oldpte, newpte);
 
   return 0;
 }
@@ -133,19 +326,21 @@ int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
  */
 int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
 {
-  struct krnl_t *krnl = caller->krnl;
+  addr_t *pte = pgd_walk(caller->mm, pgn, 1);
+  addr_t oldpte, newpte;
 
-  // For simplified implementation: use direct pgd access
-  if (krnl == NULL || krnl->mm == NULL || krnl->mm->pgd == NULL) {
+  if (pte == NULL)
     return -1;
-  }
 
-  addr_t *pte = &krnl->mm->pgd[pgn];
+  oldpte = newpte = __atomic_load_n(pte, __ATOMIC_RELAXED);
 
-  SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
-  CLRBIT(*pte, PAGING_PTE_SWAPPED_MASK);
+  SETBIT(newpte, PAGING_PTE_PRESENT_MASK);
+  CLRBIT(newpte, PAGING_PTE_SWAPPED_MASK);
 
-  SETVAL(*pte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+  SETVAL(newpte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+
+  __atomic_store_n(pte, newpte, __ATOMIC_RELEASE);
+  pte_sync_tlb(caller->mm, pgn, oldpte, newpte);
 
   return 0;
 }
@@ -158,17 +353,24 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
  **/
 uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
 {
-  struct krnl_t *krnl = caller->krnl;
-  uint32_t pte = 0;
-  
-  // For simple implementation, use direct pgd access
-  // Multi-level page tables would need full traversal through PGD->P4D->PUD->PMD->PT
-  // but current architecture uses flat pgd array
-  if (krnl != NULL && krnl->mm != NULL && krnl->mm->pgd != NULL) {
-    pte = krnl->mm->pgd[pgn];
-  }
-	
-  return pte;
+  return mm_get_pte(caller->mm, pgn);
+}
+
+/* Get PTE page table entry of an address space
+ * @mm     : page table owner
+ * @pgn    : page number
+ * @ret    : page table entry
+ **/
+uint32_t mm_get_pte(struct mm_struct *mm, addr_t pgn)
+{
+  addr_t *pte;
+
+  /* Lookups never allocate, an untouched range simply reads as empty */
+  pte = pgd_walk(mm, pgn, 0);
+  if (pte == NULL)
+    return 0;
+
+  return (uint32_t)__atomic_load_n(pte, __ATOMIC_ACQUIRE);
 }
 
 /* Set PTE page table entry
@@ -178,36 +380,109 @@ uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
  **/
 int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val)
 {
-	struct krnl_t *krnl = caller->krnl;
-	krnl->mm->pgd[pgn]=pte_val;
-	
+	addr_t *pte = pgd_walk(caller->mm, pgn, 1);
+
+	if (pte == NULL)
+		return -1;
+
+	pte_sync_tlb(caller->mm, pgn, *pte, pte_val);
+	__atomic_store_n(pte, (addr_t)pte_val, __ATOMIC_RELEASE);
+
 	return 0;
 }
 
+/*
+ * pte_set_accessed - mark a page as recently used
+ * @mm  : page table owner
+ * @pgn : page number
+ */
+int pte_set_accessed(struct mm_struct *mm, addr_t pgn)
+{
+  addr_t *pte = pgd_walk(mm, pgn, 0);
+
+  if (pte == NULL)
+    return -1;
+
+  /* Atomic so a concurrent PTE update under its stripe is not undone */
+  __atomic_fetch_or(pte, PAGING64_PTE_ACCESSED_MASK, __ATOMIC_RELAXED);
+
+  return 0;
+}
+
+/*
+ * pte_test_clear_accessed - read and clear the accessed bit of a page
+ * @mm  : page table owner
+ * @pgn : page number
+ * @ret : 1 if the page was used since the last call, 0 otherwise
+ */
+int pte_test_clear_accessed(struct mm_struct *mm, addr_t pgn)
+{
+  addr_t *pte = pgd_walk(mm, pgn, 0);
+
+  if (pte == NULL)
+    return 0;
+
+  return (__atomic_fetch_and(pte, ~PAGING64_PTE_ACCESSED_MASK, __ATOMIC_RELAXED) &
+          PAGING64_PTE_ACCESSED_MASK) != 0;
+}
+
+/*
+ * pte_set_gen - tag a page with the policy generation it was tracked in
+ * @mm  : page table owner
+ * @pgn : page number
+ * @gen : generation, 24 bits are kept
+ */
+int pte_set_gen(struct mm_struct *mm, addr_t pgn, uint32_t gen)
+{
+  addr_t *pte = pgd_walk(mm, pgn, 0);
+  addr_t old, new;
+
+  if (pte == NULL)
+    return -1;
+
+  old = __atomic_load_n(pte, __ATOMIC_RELAXED);
+  do
+  {
+    new = (old & ~PAGING64_PTE_GEN_MASK) |
+          (((addr_t)gen << PAGING64_PTE_GEN_LOBIT) & PAGING64_PTE_GEN_MASK);
+  } while (!__atomic_compare_exchange_n(pte, &old, new, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  return 0;
+}
+
+/*
+ * pte_get_gen - policy generation of a page
+ * @mm  : page table owner
+ * @pgn : page number
+ */
+uint32_t pte_get_gen(struct mm_struct *mm, addr_t pgn)
+{
+  addr_t *pte = pgd_walk(mm, pgn, 0);
+
+  if (pte == NULL)
+    return 0;
+
+  return (__atomic_load_n(pte, __ATOMIC_RELAXED) & PAGING64_PTE_GEN_MASK) >>
+         PAGING64_PTE_GEN_LOBIT;
+}
 
 /*
  * vmap_pgd_memset - map a range of page at aligned address
- * Dummy allocation for 64-bit address space emulation
+ * Populate the page directories covering the range so the later mapping
+ * of the pages does not have to allocate them, the PTEs stay empty
  */
 int vmap_pgd_memset(struct pcb_t *caller,           // process call
                     addr_t addr,                       // start address which is aligned to pagesz
                     int pgnum)                      // num of mapping page
 {
-  struct krnl_t *krnl = caller->krnl;
   int pgit = 0;
   addr_t pgn = PAGING_PGN(addr);
-  
-  // Pattern for dummy allocation (emulate page directory working)
-  uint32_t pattern = 0xDEADBEEF;
-  
-  // Memset the page table entries with pattern to emulate allocation
-  // This skips real memory allocation for 64-bit large address space
-  for (pgit = 0; pgit < pgnum; pgit++) {
-    addr_t current_pgn = pgn + pgit;
-    if (current_pgn < PAGING64_MAX_PGN) {
-      // Set dummy pattern to indicate page directory is "allocated"
-      krnl->mm->pgd[current_pgn] = pattern;
-    }
+
+  for (pgit = 0; pgit < pgnum; pgit++)
+  {
+    if (pgd_walk(caller->mm, pgn + pgit, 1) == NULL)
+      return -1;
   }
 
   return 0;
@@ -235,90 +510,219 @@ addr_t vmap_page_range(struct pcb_t *caller,           // process call
 #endif
 
   /* Map range of frames to address space
-   * in page table caller->krnl->mm->pgd[]
+   * in page table caller->mm->pgd[]
    */
   for (pgit = 0; pgit < pgnum && fpit != NULL; pgit++)
   {
     // Set page table entry with frame number
+    pte_lock(caller->mm, pgn + pgit);
     pte_set_fpn(caller, pgn + pgit, fpit->fpn);
+    pte_unlock(caller->mm, pgn + pgit);
     
     // Move to next frame
     struct framephy_struct *next_frame = fpit->fp_next;
-    free(fpit);
+    mm_pool_free(caller->mm->fp_pool, fpit);
     fpit = next_frame;
 
     /* Tracking for later page replacement activities (if needed)
      * Enqueue new usage page */
-    enlist_pgn_node(&caller->krnl->mm->fifo_pgn, pgn + pgit);
+    pgrepl_insert(caller->mm, pgn + pgit);
   }
 
   return 0;
 }
 
+/*
+ * pte_lock - serialize the updates of the PTE of a page
+ * @mm  : page table owner
+ * @pgn : page number
+ */
+void pte_lock(struct mm_struct *mm, addr_t pgn)
+{
+  pthread_mutex_t *lock = &mm->pte_lock[pgn & (MM_PTE_LOCK_STRIPES - 1)];
+
+  pthread_mutex_lock(lock);
+  pte_lock_held = lock;
+}
+
+/*
+ * pte_unlock - release the PTE lock of a page
+ * @mm  : page table owner
+ * @pgn : page number
+ */
+void pte_unlock(struct mm_struct *mm, addr_t pgn)
+{
+  pte_lock_held = NULL;
+  pthread_mutex_unlock(&mm->pte_lock[pgn & (MM_PTE_LOCK_STRIPES - 1)]);
+}
+
+/*
+ * swap_out_victim - evict one page of an address space to MEMSWP
+ * @caller : owner of the address space
+ * @fpn    : returned MEMRAM frame the victim was using
+ * The frame is handed to the caller, it is not put back to the free list.
+ * The victim PTE stripe is only tried: a victim whose stripe is busy stays
+ * resident and another one is picked. The policy gets the busy ones back
+ * once done, not to pick them again right away.
+ */
+int swap_out_victim(struct pcb_t *caller, addr_t *fpn)
+{
+  struct mm_struct *mm = caller->mm;
+  pthread_mutex_t *lock = NULL;
+  addr_t vicpgn, swpfpn;
+  addr_t busy[SWAP_OUT_TRIES];
+  uint32_t pte;
+  int try, nbusy = 0, ret = -1;
+
+  for (try = 0; try < SWAP_OUT_TRIES; try++)
+  {
+    if (find_victim_page(mm, &vicpgn) == -1)
+      goto out;
+
+    /* The fault in progress on this thread may own the stripe already */
+    lock = &mm->pte_lock[vicpgn & (MM_PTE_LOCK_STRIPES - 1)];
+    if (lock == pte_lock_held)
+      lock = NULL;
+    else if (pthread_mutex_trylock(lock) != 0)
+    {
+      busy[nbusy++] = vicpgn;
+      continue;
+    }
+
+    pte = mm_get_pte(mm, vicpgn);
+    if (PAGING_PAGE_PRESENT(pte) && !(pte & PAGING_PTE_SWAPPED_MASK))
+      break;
+
+    /* Went away between the policy and the lock, nothing to evict */
+    if (lock != NULL)
+      pthread_mutex_unlock(lock);
+  }
+
+  if (try == SWAP_OUT_TRIES)
+    goto out;
+
+  if (MEMPHY_alloc_frame(caller->krnl->active_mswp, &swpfpn) == -1)
+  {
+    /* Swap space is full, the victim stays online */
+    pgrepl_putback(mm, vicpgn);
+    if (lock != NULL)
+      pthread_mutex_unlock(lock);
+    goto out;
+  }
+
+  *fpn = PAGING_FPN(pte);
+  __swap_cp_page(caller->krnl->mram, *fpn, caller->krnl->active_mswp, swpfpn);
+  pte_set_swap(caller, vicpgn, 0, swpfpn);
+
+  if (lock != NULL)
+    pthread_mutex_unlock(lock);
+  ret = 0;
+
+out:
+  while (nbusy > 0)
+    pgrepl_putback(mm, busy[--nbusy]);
+
+  return ret;
+}
+
+/*
+ * get_free_frame - get a MEMRAM frame for a page of the caller
+ * @caller : caller
+ * @fpn    : returned frame number
+ * A free frame is used when there is one, the reclaim daemon works to
+ * keep it so. Otherwise a page of the caller is swapped out on the spot,
+ * or of an idle process when the caller has none left in MEMRAM.
+ */
+int get_free_frame(struct pcb_t *caller, addr_t *fpn)
+{
+  if (MEMPHY_alloc_frame(caller->krnl->mram, fpn) == 0)
+    return 0;
+
+  if (swap_out_victim(caller, fpn) == 0)
+    return 0;
+
+  return mm_reclaim_direct(caller, fpn);
+}
+
+/* Give back the frames of a list being built by alloc_pages_range */
+static void free_frm_lst(struct pcb_t *caller, struct framephy_struct **frm_lst)
+{
+  struct framephy_struct *freefp_str;
+
+  while (*frm_lst != NULL)
+  {
+    freefp_str = *frm_lst;
+    *frm_lst = (*frm_lst)->fp_next;
+    MEMPHY_free_frame(caller->krnl->mram, freefp_str->fpn);
+    mm_pool_free(caller->mm->fp_pool, freefp_str);
+  }
+}
+
 /*
  * alloc_pages_range - allocate req_pgnum of frame in ram
  * @caller    : caller
  * @req_pgnum : request page num
  * @frm_lst   : frame list
+ * Frames are taken as contiguous runs, the largest the buddy allocator can
+ * give for what is left, and listed in ascending order so consecutive
+ * pages land on consecutive frames. Victims are swapped out one frame at
+ * a time only once no run is left.
  */
 
 addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_struct **frm_lst)
 {
   addr_t fpn;
-  int pgit;
+  int pgit = 0, run, order, i;
   struct framephy_struct *newfp_str = NULL;
+  struct framephy_struct **tail = frm_lst;
+
+  while (*tail != NULL)
+    tail = &(*tail)->fp_next;
 
-  for (pgit = 0; pgit < req_pgnum; pgit++)
+  while (pgit < req_pgnum)
   {
-    newfp_str = (struct framephy_struct *)malloc(sizeof(struct framephy_struct));
-    
-    // Try to get free frame from RAM
-    if (MEMPHY_get_freefp(caller->krnl->mram, &fpn) == 0)
+    /* Largest power of two run not past the request */
+    for (order = 0; (2 << order) <= req_pgnum - pgit; order++)
+      ;
+
+    while (order > 0 && MEMPHY_alloc_frames(caller->krnl->mram, order, &fpn) != 0)
+      order--;
+
+    if (order > 0)
+      run = 1 << order;
+    else if (get_free_frame(caller, &fpn) == 0)
+      run = 1;
+    else
     {
-      newfp_str->fpn = fpn;
+      // Cannot find victim or swap space full
+      if (*frm_lst == NULL)
+        return -1;
+
+      // Give back the frames taken so far and return error
+      free_frm_lst(caller, frm_lst);
+      return -3000; // Out of memory
     }
-    else
+
+    for (i = 0; i < run; i++)
     {
-      // Out of free frames - need to swap out a victim page
-      addr_t vicpgn, swpfpn;
-      
-      if (find_victim_page(caller->krnl->mm, &vicpgn) == -1 || 
-          MEMPHY_get_freefp(caller->krnl->active_mswp, &swpfpn) == -1)
+      newfp_str = (struct framephy_struct *)mm_pool_alloc(caller->mm->fp_pool);
+      if (newfp_str == NULL)
       {
-        // Cannot find victim or swap space full
-        if (*frm_lst == NULL)
-        {
-          free(newfp_str);
-          return -1;
-        }
-        else
-        {
-          // Free allocated frames and return error
-          struct framephy_struct *freefp_str;
-          while (*frm_lst != NULL)
-          {
-            freefp_str = *frm_lst;
-            *frm_lst = (*frm_lst)->fp_next;
-            free(freefp_str);
-          }
-          free(newfp_str);
-          return -3000; // Out of memory
-        }
+        /* The rest of the run is not listed yet */
+        for (; i < run; i++)
+          MEMPHY_free_frame(caller->krnl->mram, fpn + i);
+        free_frm_lst(caller, frm_lst);
+        return -1;
       }
-      
-      // Swap victim page out
-      uint32_t vicpte = pte_get_entry(caller, vicpgn);
-      addr_t vicfpn = PAGING_FPN(vicpte);
-      __swap_cp_page(caller->krnl->mram, vicfpn, caller->krnl->active_mswp, swpfpn);
-      pte_set_swap(caller, vicpgn, 0, swpfpn);
-      
-      // Use the victim's frame
-      newfp_str->fpn = vicfpn;
+      newfp_str->fpn = fpn + i;
+      newfp_str->fp_next = NULL;
+
+      // Add to frame list
+      *tail = newfp_str;
+      tail = &newfp_str->fp_next;
     }
-    
-    // Add to frame list
-    newfp_str->fp_next = *frm_lst;
-    *frm_lst = newfp_str;
+
+    pgit += run;
   }
 
   return 0;
@@ -364,6 +768,154 @@ addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapst
   return 0;
 }
 
+/*
+ * Frame and buffer granular MEMPHY transfers. A random access memphy
+ * moves a whole run with one bounds check and one memcpy, a sequential
+ * access memphy keeps going through MEMPHY_read/MEMPHY_write so its
+ * cursor is honoured.
+ */
+static BYTE *memphy_span(struct memphy_struct *mp, addr_t addr, addr_t len)
+{
+  if (mp == NULL || mp->storage == NULL || !mp->rdmflg ||
+      addr + len > (addr_t)mp->maxsz || addr + len < addr)
+    return NULL;
+
+  return mp->storage + addr;
+}
+
+static BYTE *memphy_frame(struct memphy_struct *mp, addr_t fpn)
+{
+  return memphy_span(mp, fpn * PAGING_PAGESZ, PAGING_PAGESZ);
+}
+
+/*
+ * MEMPHY_read_buf - read a run of bytes
+ * @mp   : memphy
+ * @addr : physical address of the first byte
+ * @buf  : destination buffer
+ * @len  : number of bytes
+ */
+int MEMPHY_read_buf(struct memphy_struct *mp, addr_t addr, BYTE *buf, addr_t len)
+{
+  BYTE *src = memphy_span(mp, addr, len);
+  addr_t i;
+
+  if (src != NULL)
+  {
+    memcpy(buf, src, len);
+    return 0;
+  }
+
+  for (i = 0; i < len; i++)
+    if (MEMPHY_read(mp, addr + i, &buf[i]) != 0)
+      return -1;
+
+  return 0;
+}
+
+/*
+ * MEMPHY_write_buf - write a run of bytes
+ * @mp   : memphy
+ * @addr : physical address of the first byte
+ * @buf  : source buffer
+ * @len  : number of bytes
+ */
+int MEMPHY_write_buf(struct memphy_struct *mp, addr_t addr, const BYTE *buf, addr_t len)
+{
+  BYTE *dst = memphy_span(mp, addr, len);
+  addr_t i;
+
+  if (dst != NULL)
+  {
+    memcpy(dst, buf, len);
+    return 0;
+  }
+
+  for (i = 0; i < len; i++)
+    if (MEMPHY_write(mp, addr + i, buf[i]) != 0)
+      return -1;
+
+  return 0;
+}
+
+/*
+ * MEMPHY_read_frame - read a whole frame
+ * @mp  : memphy
+ * @fpn : frame number
+ * @buf : PAGING_PAGESZ bytes destination buffer
+ */
+int MEMPHY_read_frame(struct memphy_struct *mp, addr_t fpn, BYTE *buf)
+{
+  BYTE *frm = memphy_frame(mp, fpn);
+  int cellidx;
+
+  if (frm != NULL)
+  {
+    memcpy(buf, frm, PAGING_PAGESZ);
+    return 0;
+  }
+
+  for (cellidx = 0; cellidx < PAGING_PAGESZ; cellidx++)
+    if (MEMPHY_read(mp, fpn * PAGING_PAGESZ + cellidx, &buf[cellidx]) != 0)
+      return -1;
+
+  return 0;
+}
+
+/*
+ * MEMPHY_write_frame - write a whole frame
+ * @mp  : memphy
+ * @fpn : frame number
+ * @buf : PAGING_PAGESZ bytes source buffer
+ */
+int MEMPHY_write_frame(struct memphy_struct *mp, addr_t fpn, const BYTE *buf)
+{
+  BYTE *frm = memphy_frame(mp, fpn);
+  int cellidx;
+
+  if (frm != NULL)
+  {
+    memcpy(frm, buf, PAGING_PAGESZ);
+    return 0;
+  }
+
+  for (cellidx = 0; cellidx < PAGING_PAGESZ; cellidx++)
+    if (MEMPHY_write(mp, fpn * PAGING_PAGESZ + cellidx, buf[cellidx]) != 0)
+      return -1;
+
+  return 0;
+}
+
+/*
+ * MEMPHY_copy_frame - copy a frame between (or inside) memphy devices
+ * @mpsrc  : source memphy
+ * @srcfpn : source frame number
+ * @mpdst  : destination memphy
+ * @dstfpn : destination frame number
+ */
+int MEMPHY_copy_frame(struct memphy_struct *mpsrc, addr_t srcfpn,
+                      struct memphy_struct *mpdst, addr_t dstfpn)
+{
+  BYTE *src = memphy_frame(mpsrc, srcfpn);
+  BYTE *dst = memphy_frame(mpdst, dstfpn);
+  BYTE buf[PAGING_PAGESZ];
+
+  if (src != NULL && dst != NULL)
+  {
+    /* Same device and same frame never overlap partially */
+    memmove(dst, src, PAGING_PAGESZ);
+    return 0;
+  }
+
+  /* At least one side is sequential, bounce through a frame buffer */
+  if (src != NULL)
+    memcpy(buf, src, PAGING_PAGESZ);
+  else if (MEMPHY_read_frame(mpsrc, srcfpn, buf) != 0)
+    return -1;
+
+  return MEMPHY_write_frame(mpdst, dstfpn, buf);
+}
+
 /* Swap copy content page from source frame to destination frame
  * @mpsrc  : source memphy
  * @srcfpn : source physical page number (FPN)
@@ -373,19 +925,7 @@ addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapst
 int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
                    struct memphy_struct *mpdst, addr_t dstfpn)
 {
-  int cellidx;
-  addr_t addrsrc, addrdst;
-  for (cellidx = 0; cellidx < PAGING_PAGESZ; cellidx++)
-  {
-    addrsrc = srcfpn * PAGING_PAGESZ + cellidx;
-    addrdst = dstfpn * PAGING_PAGESZ + cellidx;
-
-    BYTE data;
-    MEMPHY_read(mpsrc, addrsrc, &data);
-    MEMPHY_write(mpdst, addrdst, data);
-  }
-
-  return 0;
+  return MEMPHY_copy_frame(mpsrc, srcfpn, mpdst, dstfpn);
 }
 
 /*
@@ -397,54 +937,48 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
 {
   struct vm_area_struct *vma0 = malloc(sizeof(struct vm_area_struct));
 
-  // Allocate page global directory
-  // Use PAGING64_MAX_PGN for 64-bit mode (much smaller, realistic size)
-  mm->pgd = malloc(PAGING64_MAX_PGN * sizeof(addr_t));
+  /* Only the page global directory is allocated up front, the lower
+   * levels are brought up on demand by the page table walk */
+  mm->pgd = calloc(pd_nentry[0], sizeof(addr_t));
   if (mm->pgd == NULL) {
-    printf("[ERROR] Failed to allocate PGD: size=%lu bytes\n", 
-           PAGING64_MAX_PGN * sizeof(addr_t));
+    printf("[ERROR] Failed to allocate PGD: size=%lu bytes\n",
+           (unsigned long)(pd_nentry[0] * sizeof(addr_t)));
     free(vma0);
     return -1;
   }
-  
-  // Allocate other page table levels for 64-bit paging
-  mm->p4d = malloc(PAGING64_MAX_PGN * sizeof(addr_t));
-  mm->pud = malloc(PAGING64_MAX_PGN * sizeof(addr_t));
-  mm->pmd = malloc(PAGING64_MAX_PGN * sizeof(addr_t));
-  mm->pt = malloc(PAGING64_MAX_PGN * sizeof(addr_t));
-  
-  if (mm->p4d == NULL || mm->pud == NULL || mm->pmd == NULL || mm->pt == NULL) {
-    printf("[ERROR] Failed to allocate page tables\n");
+
+  /* Lower level tables hang off the PGD entries */
+  mm->p4d = NULL;
+  mm->pud = NULL;
+  mm->pmd = NULL;
+  mm->pt = NULL;
+
+  mm->pte_lock = malloc(MM_PTE_LOCK_STRIPES * sizeof(pthread_mutex_t));
+  if (mm->pte_lock == NULL) {
     free(mm->pgd);
-    free(mm->p4d);
-    free(mm->pud);
-    free(mm->pmd);
-    free(mm->pt);
     free(vma0);
     return -1;
   }
-  
-  // Initialize all page table entries to 0
-  for (int i = 0; i < PAGING64_MAX_PGN; i++) {
-    mm->pgd[i] = 0;
-    mm->p4d[i] = 0;
-    mm->pud[i] = 0;
-    mm->pmd[i] = 0;
-    mm->pt[i] = 0;
-  }
+  for (int i = 0; i < MM_PTE_LOCK_STRIPES; i++)
+    pthread_mutex_init(&mm->pte_lock[i], NULL);
+  pthread_rwlock_init(&mm->mmap_lock, NULL);
+  pthread_mutex_init(&mm->run_lock, NULL);
 
-  /* TODO init page table directory */
-  // For 64-bit, would need to init multi-level tables:
-  // mm->p4d, mm->pud, mm->pmd, mm->pt
-  // But current simple implementation uses flat pgd array
+  /* Tag the address space so cached translations of several processes
+   * can stay resident side by side */
+  pthread_mutex_lock(&asid_lock);
+  mm->asid = asid_next++;
+  pthread_mutex_unlock(&asid_lock);
 
   /* By default the owner comes with at least one vma */
   vma0->vm_id = 0;
   vma0->vm_start = 0;
   vma0->vm_end = vma0->vm_start;
   vma0->sbrk = vma0->vm_start;
-  struct vm_rg_struct *first_rg = init_vm_rg(vma0->vm_start, vma0->vm_end);
-  enlist_vm_rg_node(&vma0->vm_freerg_list, first_rg);
+  vma0->vm_freerg_list = NULL;
+
+  /* Free regions come from __free(), an empty area has none */
+  vma0->vm_freerg = NULL;
 
   vma0->vm_next = NULL;
 
@@ -463,9 +997,89 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
   // Initialize FIFO page list
   mm->fifo_pgn = NULL;
 
+  /* Frame list nodes of alloc_pages_range() are recycled per mm */
+  mm->fp_pool = mm_pool_create(sizeof(struct framephy_struct), 64);
+  if (mm->fp_pool == NULL)
+    return -1;
+
+  /* Resident pages are tracked by the configured replacement policy */
+  if (pgrepl_init(mm) != 0)
+    return -1;
+
+  /* Let the reclaim daemon take frames from this address space */
+  mm_reclaim_register(caller);
+
   return 0;
 }
 
+/*
+ * free_mm - release a Memory Management instance
+ * @mm: self mm
+ * The frames still held by the address space are returned separately
+ * through free_pcb_memph(), the mm_struct itself belongs to the caller
+ */
+int free_mm(struct mm_struct *mm)
+{
+  struct vm_area_struct *vma = mm->mmap;
+  struct pgn_t *pg;
+
+  while (vma != NULL)
+  {
+    struct vm_area_struct *nvma = vma->vm_next;
+
+    vm_freerg_destroy(vma);
+    free(vma);
+    vma = nvma;
+  }
+  mm->mmap = NULL;
+
+  while ((pg = mm->fifo_pgn) != NULL)
+  {
+    mm->fifo_pgn = pg->pg_next;
+    free(pg);
+  }
+
+  pgrepl_destroy(mm);
+
+  mm_pool_destroy(mm->fp_pool);
+  mm->fp_pool = NULL;
+
+  free_pgd(mm);
+
+  for (int i = 0; i < MM_PTE_LOCK_STRIPES; i++)
+    pthread_mutex_destroy(&mm->pte_lock[i]);
+  free(mm->pte_lock);
+  mm->pte_lock = NULL;
+  pthread_rwlock_destroy(&mm->mmap_lock);
+  pthread_mutex_destroy(&mm->run_lock);
+
+  return 0;
+}
+
+/*
+ * mm_run_begin - the owner of an address space goes on a CPU
+ * @mm: self mm
+ * Held until mm_run_end(), this keeps the reclaim daemon from evicting
+ * pages the CPU reads through its TLB without locking. The invalidations
+ * the daemon posted before are applied first.
+ */
+void mm_run_begin(struct mm_struct *mm)
+{
+  pthread_mutex_lock(&mm->run_lock);
+#ifdef CPU_TLB
+  tlb_shootdown_drain();
+#endif
+}
+
+/*
+ * mm_run_end - the owner of an address space leaves the CPU
+ * @mm: self mm
+ */
+void mm_run_end(struct mm_struct *mm)
+{
+  pthread_mutex_unlock(&mm->run_lock);
+}
+
 struct vm_rg_struct *init_vm_rg(addr_t rg_start, addr_t rg_end)
 {
   struct vm_rg_struct *rgnode = malloc(sizeof(struct vm_rg_struct));
@@ -558,26 +1172,32 @@ int print_list_pgn(struct pgn_t *ip)
   return 0;
 }
 
+struct pgtbl_range {
+  addr_t start;
+  addr_t end;
+};
+
+static int print_pte(addr_t pgn, addr_t *pte, void *arg)
+{
+  struct pgtbl_range *rg = arg;
+  addr_t addr = pgn * PAGING64_PAGESZ;
+
+  if (addr >= rg->start && addr < rg->end)
+    printf("%016lx: %08x\n", (unsigned long)addr, (uint32_t)*pte);
+
+  return 0;
+}
+
 int print_pgtbl(struct pcb_t *caller, addr_t start, addr_t end)
 {
-//  addr_t pgn_start;//, pgn_end;
-//  addr_t pgit;
+  struct pgtbl_range rg = { start, end };
 
-  /* Print addresses of page table structures from mm_struct */
+  /* Print the root of the page directory tree */
   printf("print_pgtbl:\n");
-  printf(" PDG=%lx P4g=%lx PUD=%lx PMD=%lx\n", 
-         (unsigned long)caller->krnl->mm->pgd,
-         (unsigned long)caller->krnl->mm->p4d, 
-         (unsigned long)caller->krnl->mm->pud,
-         (unsigned long)caller->krnl->mm->pmd);
-
-  /* Optionally print non-zero PGD entries */
-  int i;
-  for (i = 0; i < PAGING64_MAX_PGN; i++) {
-    if (caller->krnl->mm->pgd[i] != 0) {
-       printf("%08ld: %08x\n", i * PAGING64_PAGESZ, caller->krnl->mm->pgd[i]);
-    }
-  }
+  printf(" PDG=%lx\n", (unsigned long)caller->mm->pgd);
+
+  /* Print the non-empty PTEs within [start, end) */
+  pgd_for_each_pte(caller->mm, print_pte, &rg);
 
   return 0;
 }
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * Bounded lock-free multi-producer multi-consumer queue of processes
+ *
+ * A ring of cells, each stamped with a sequence number telling which lap
+ * of the ring it is ready for: a producer claims the tail cell when its
+ * stamp equals the tail position, a consumer claims the head cell when
+ * the stamp is one past the head position. Claiming is a CAS on the
+ * position, filling or emptying the cell then publishes the next stamp.
+ * Producers and consumers only meet on a cell, never on a lock, and the
+ * queue keeps FIFO order.
+ */
+
+#include "common.h"
+#include "queue.h"
+#include <stdlib.h>
+
+struct mpmc_cell {
+	unsigned long seq;
+	struct pcb_t * proc;
+};
+
+struct mpmc_queue {
+	unsigned long mask;
+	struct mpmc_cell * cell;
+	/* Producers and consumers do not share a cache line */
+	unsigned long tail __attribute__((aligned(64)));
+	unsigned long head __attribute__((aligned(64)));
+};
+
+/*
+ * mpmc_create - create a queue
+ * @capacity : processes it holds at most, rounded up to a power of two
+ */
+struct mpmc_queue * mpmc_create(int capacity) {
+	struct mpmc_queue * q;
+	unsigned long size = 2, i;
+
+	while (size < (unsigned long)capacity)
+		size <<= 1;
+
+	if (posix_memalign((void **)&q, 64, sizeof(struct mpmc_queue)) != 0)
+		return NULL;
+
+	q->cell = malloc(size * sizeof(struct mpmc_cell));
+	if (q->cell == NULL) {
+		free(q);
+		return NULL;
+	}
+
+	for (i = 0; i < size; i++)
+		q->cell[i].seq = i;
+	q->mask = size - 1;
+	q->head = q->tail = 0;
+
+	return q;
+}
+
+void mpmc_destroy(struct mpmc_queue * q) {
+	if (q == NULL)
+		return;
+
+	free(q->cell);
+	free(q);
+}
+
+/*
+ * mpmc_push - append a process
+ * Return -1 when the queue is full.
+ */
+int mpmc_push(struct mpmc_queue * q, struct pcb_t * proc) {
+	unsigned long pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+	struct mpmc_cell * c;
+
+	for (;;) {
+		long dif;
+
+		c = &q->cell[pos & q->mask];
+		dif = (long)(__atomic_load_n(&c->seq, __ATOMIC_ACQUIRE) - pos);
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			/* Still holds the process of the previous lap */
+			return -1;
+		} else {
+			pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	c->proc = proc;
+	__atomic_store_n(&c->seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*
+ * mpmc_pop - take the oldest process
+ * Return NULL when the queue is empty.
+ */
+struct pcb_t * mpmc_pop(struct mpmc_queue * q) {
+	unsigned long pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+	struct mpmc_cell * c;
+	struct pcb_t * proc;
+
+	for (;;) {
+		long dif;
+
+		c = &q->cell[pos & q->mask];
+		dif = (long)(__atomic_load_n(&c->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			/* Not filled yet */
+			return NULL;
+		} else {
+			pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	proc = c->proc;
+	/* Ready for the producer of the next lap */
+	__atomic_store_n(&c->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+	return proc;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * Batch mode
+ *
+ * Runs a list of configs, at most a number of them at a time. Every
+ * simulation instance is a child process: the clock, the run queues, the
+ * TLBs and the memory of the simulator are global, each instance needs
+ * its own. Whatever the parent set up before, the program images in
+ * particular, is shared copy on write by all of them. An instance writes
+ * what it prints to output/<config>.log.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static pid_t batch_start(const char * cfg, int (*run)(const char * cfg)) {
+	char log[256];
+	pid_t pid = fork();
+
+	if (pid != 0)
+		return pid;
+
+	snprintf(log, sizeof(log), "output/%s.log", cfg);
+	if (freopen(log, "w", stdout) == NULL) {
+		fprintf(stderr, "Cannot write %s\n", log);
+		_exit(1);
+	}
+	exit(run(cfg));
+}
+
+/*
+ * batch_run - run configs concurrently
+ * @jobs : instances running at a time, 0 for one per host CPU
+ * @run  : simulation of a config, returns its exit status
+ * Return the number of instances that failed.
+ */
+int batch_run(int nconf, char ** conf, int jobs, int (*run)(const char * cfg)) {
+	pid_t * pid = calloc(nconf, sizeof(pid_t));
+	int next = 0, running = 0, failed = 0;
+
+	if (pid == NULL)
+		return nconf;
+	if (jobs <= 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs <= 0)
+		jobs = 1;
+
+	/* Nothing buffered twice */
+	fflush(stdout);
+
+	while (next < nconf || running > 0) {
+		int status, i;
+		pid_t done;
+
+		if (next < nconf && running < jobs) {
+			pid[next] = batch_start(conf[next], run);
+			if (pid[next] < 0) {
+				printf("Cannot start %s\n", conf[next]);
+				fflush(stdout);
+				failed++;
+			} else {
+				running++;
+			}
+			next++;
+			continue;
+		}
+
+		done = wait(&status);
+		if (done < 0)
+			break;
+		for (i = 0; i < next && pid[i] != done; i++)
+			;
+		if (i == next)
+			continue;
+
+		running--;
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			printf("%s: done, output/%s.log\n", conf[i], conf[i]);
+		} else {
+			printf("%s: failed\n", conf[i]);
+			failed++;
+		}
+		fflush(stdout);
+	}
+
+	free(pid);
+	return failed;
+}
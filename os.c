@@ -6,6 +6,7 @@
 #include "mm.h"
 
 #include <pthread.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -13,11 +14,14 @@
 static int time_slot;
 static int num_cpus;
 static int done = 0;
+static int cpus_stopped = 0;
 static struct krnl_t os;
 
 #ifdef MM_PAGING
 static int memramsz;
 static int memswpsz[PAGING_MAX_MMSWP];
+static int reclaim_low = -1;
+static int reclaim_high = -1;
 
 struct mmpaging_ld_args {
 	/* A dispatched argument struct to compact many-fields passing to loader */
@@ -26,141 +30,416 @@ struct mmpaging_ld_args {
 	struct memphy_struct **mswp;
 	struct memphy_struct *active_mswp;
 	int active_mswp_id;
-	struct timer_id_t  *timer_id;
+	struct slot_event *timer_id;
 };
 #endif
 
-static struct ld_args{
-	char ** path;
-	unsigned long * start_time;
-#ifdef MLQ_SCHED
-	unsigned long * prio;
-#endif
-} ld_processes;
+/* Process list of the config file, read one entry at a time by the
+ * loader */
+static struct ld_stream {
+	FILE * file;
+	int left;		/* entries not read yet */
+} ld_stream;
 int num_processes;
 
+struct ld_entry {
+	unsigned long start_time;
+	unsigned long prio;
+	char path[100];		/* as long as the path of a PCB */
+	struct pcb_t * proc;	/* loaded ahead of start_time */
+};
+
+/* Processes are loaded this many slots before they start (LOAD_AHEAD
+ * option), at most LD_AHEAD_MAX of them at a time */
+#define LD_AHEAD_MAX 64
+static int ld_ahead = 2;
+
 struct cpu_args {
-	struct timer_id_t * timer_id;
+	struct slot_event * timer_id;
 	int id;
+	/* Kept from one slot to the next */
+	struct pcb_t * proc;
+	int time_left;
+	int stopped;
+};
+
+/* How a CPU waits after a slot */
+enum cpu_wait {
+	CPU_NEXT,	/* runs again in the next slot */
+	CPU_IDLE,	/* nothing to run */
+	CPU_STOP,	/* the loader is done and so is the CPU */
 };
 
+/* Simulated CPUs multiplexed on this many host threads, 0 for a thread
+ * per CPU */
+static int cpu_workers = 0;
+static struct cpu_args * worker_cpu;
+static int worker_claim[2];
+
+static void cpu_bind(int id) {
+#ifdef CPU_TLB
+	/* Translations cached from now on land in this CPU's TLB */
+	tlb_bind_cpu(id);
+#endif
+#ifdef MM_PAGING
+	/* Single frames come from this CPU's frame cache */
+	MEMPHY_bind_cpu(id);
+#endif
+	/* Dispatch from this CPU's run queue */
+	rq_bind_cpu(id);
+}
+
+/* One time slot of a CPU, the calling thread is bound to it */
+static enum cpu_wait cpu_step(struct cpu_args * cpu) {
+	struct pcb_t * proc = cpu->proc;
+	int id = cpu->id;
+
+#ifdef CPU_TLB
+	/* Apply the TLB invalidations other CPUs queued for us */
+	tlb_shootdown_drain();
+#endif
+	/* Check the status of current process */
+	if (proc == NULL) {
+		/* No process is running, the we load new process from
+		 * ready queue */
+		proc = rq_get_proc();
+		/* Nothing to load falls to the recheck below, which
+		 * stops the CPU once the loader is done */
+	}else if (proc->pc == proc->code->size) {
+		/* The porcess has finish it job */
+		printf("\tCPU %d: Processed %2d has finished\n",
+			id ,proc->pid);
+#ifdef CPU_TLB
+		tlb_flush_tlb_of(proc);
+#endif
+#ifdef MM_PAGING
+		free_pcb_memph(proc);
+		free_mm(proc->mm);
+		free(proc->mm);
+#endif
+		pid_index_del(proc->krnl, proc);
+		ld_image_put(proc);
+		free(proc);
+		proc = rq_get_proc();
+		cpu->time_left = 0;
+	}else if (cpu->time_left == 0) {
+		/* The process has done its job in current time slot */
+		printf("\tCPU %d: Put process %2d to run queue\n",
+			id, proc->pid);
+		rq_put_proc(proc);
+		proc = rq_get_proc();
+	}
+	cpu->proc = proc;
+
+	/* Recheck process status after loading new process. A CPU that
+	 * found nothing may only have been refused processes still cache
+	 * hot on their CPU: it stops once no run queue holds any */
+	if (proc == NULL && __atomic_load_n(&done, __ATOMIC_ACQUIRE) &&
+	    rq_nr_queued() == 0) {
+		/* No process to run, exit */
+		printf("\tCPU %d stopped\n", id);
+		__atomic_add_fetch(&cpus_stopped, 1, __ATOMIC_RELEASE);
+		return CPU_STOP;
+	}else if (proc == NULL) {
+		/* There may be new processes to run in
+		 * next time slots, just skip current slot */
+		return CPU_IDLE;
+	}else if (cpu->time_left == 0) {
+		printf("\tCPU %d: Dispatched process %2d\n",
+			id, proc->pid);
+		cpu->time_left = rq_slice(proc, time_slot);
+	}
+
+	/* Run current process */
+#ifdef MM_PAGING
+	mm_run_begin(proc->mm);
+#endif
+	run_decoded(proc);
+#ifdef MM_PAGING
+	mm_run_end(proc->mm);
+#endif
+	cpu->time_left--;
+	return CPU_NEXT;
+}
 
 static void * cpu_routine(void * args) {
-	struct timer_id_t * timer_id = ((struct cpu_args*)args)->timer_id;
-	int id = ((struct cpu_args*)args)->id;
-	/* Check for new process in ready queue */
-	int time_left = 0;
-	struct pcb_t * proc = NULL;
-	while (1) {
-		/* Check the status of current process */
-		if (proc == NULL) {
-			/* No process is running, the we load new process from
-		 	* ready queue */
-			proc = get_proc();
-			if (proc == NULL) {
-                           next_slot(timer_id);
-                           continue; /* First load failed. skip dummy load */
-                        }
-		}else if (proc->pc == proc->code->size) {
-			/* The porcess has finish it job */
-			printf("\tCPU %d: Processed %2d has finished\n",
-				id ,proc->pid);
-			free(proc);
-			proc = get_proc();
-			time_left = 0;
-		}else if (time_left == 0) {
-			/* The process has done its job in current time slot */
-			printf("\tCPU %d: Put process %2d to run queue\n",
-				id, proc->pid);
-			put_proc(proc);
-			proc = get_proc();
-		}
-		
-		/* Recheck process status after loading new process */
-		if (proc == NULL && done) {
-			/* No process to run, exit */
-			printf("\tCPU %d stopped\n", id);
-			break;
-		}else if (proc == NULL) {
-			/* There may be new processes to run in
-			 * next time slots, just skip current slot */
-			next_slot(timer_id);
-			continue;
-		}else if (time_left == 0) {
-			printf("\tCPU %d: Dispatched process %2d\n",
-				id, proc->pid);
-			time_left = time_slot;
+	struct cpu_args * cpu = (struct cpu_args*)args;
+	enum cpu_wait wait;
+
+	cpu_bind(cpu->id);
+	while ((wait = cpu_step(cpu)) != CPU_STOP) {
+		if (wait == CPU_IDLE)
+			slot_next_idle(cpu->timer_id);
+		else
+			slot_next(cpu->timer_id);
+	}
+	slot_detach(cpu->timer_id);
+	pthread_exit(NULL);
+}
+
+/*
+ * Host thread running the slots of any simulated CPU. In every slot the
+ * workers claim the CPUs one by one from a shared counter, then wait for
+ * the next slot as the most demanding CPU they ran. Claim counters
+ * alternate between slots: whoever claims the first CPU of a slot resets
+ * the counter of the next one, nobody uses it before the slot ends.
+ */
+static void * worker_routine(void * args) {
+	struct slot_event * timer_id = (struct slot_event*)args;
+	unsigned long round = 0;
+
+	while (__atomic_load_n(&cpus_stopped, __ATOMIC_ACQUIRE) < num_cpus) {
+		int * claim = &worker_claim[round & 1];
+		enum cpu_wait wait = CPU_STOP;
+		int i;
+
+		while ((i = __atomic_fetch_add(claim, 1, __ATOMIC_RELAXED)) < num_cpus) {
+			struct cpu_args * cpu = &worker_cpu[i];
+			enum cpu_wait w;
+
+			if (i == 0)
+				__atomic_store_n(&worker_claim[(round + 1) & 1], 0,
+						 __ATOMIC_RELAXED);
+			if (cpu->stopped)
+				continue;
+
+			cpu_bind(cpu->id);
+			w = cpu_step(cpu);
+			if (w == CPU_STOP)
+				cpu->stopped = 1;
+			else if (w < wait)	/* CPU_NEXT before CPU_IDLE */
+				wait = w;
 		}
-		
-		/* Run current process */
-		run(proc);
-		time_left--;
-		next_slot(timer_id);
+		round++;
+
+		if (wait == CPU_NEXT)
+			slot_next(timer_id);
+		else
+			slot_next_idle(timer_id);
 	}
-	detach_event(timer_id);
+	cpu_bind(-1);
+	slot_detach(timer_id);
 	pthread_exit(NULL);
 }
 
+#ifdef MM_PAGING
+static void * kswapd_routine(void * args) {
+	struct slot_event * timer_id = (struct slot_event*)args;
+
+	/* Reclaim ahead of demand for as long as a CPU may fault */
+	while (__atomic_load_n(&cpus_stopped, __ATOMIC_ACQUIRE) < num_cpus) {
+		/* Nothing to reclaim, no need to hold the clock */
+		if (mm_reclaim(&os) > 0)
+			slot_next(timer_id);
+		else
+			slot_next_idle(timer_id);
+	}
+	slot_detach(timer_id);
+	pthread_exit(NULL);
+}
+#endif
+
+/* Next entry of the process list. One whose path does not fit in a PCB
+ * is reported and skipped */
+static int ld_read_entry(struct ld_entry * e) {
+	char proc[100];
+	int c, too_long;
+
+	for (;;) {
+		if (ld_stream.left == 0)
+			return -1;
+		ld_stream.left--;
+
+		e->prio = 0;
+		if (fscanf(ld_stream.file, "%lu %99s", &e->start_time, proc) != 2)
+			return -1;
+		/* Whatever %99s left of a longer name */
+		c = fgetc(ld_stream.file);
+		too_long = c != EOF && !isspace(c);
+		if (too_long)
+			fscanf(ld_stream.file, "%*s");
+		else if (c != EOF)
+			ungetc(c, ld_stream.file);
+#ifdef MLQ_SCHED
+		if (fscanf(ld_stream.file, "%lu", &e->prio) != 1)
+			return -1;
+#endif
+		fscanf(ld_stream.file, "\n");
+
+		if (!too_long && snprintf(e->path, sizeof(e->path), "input/proc/%s",
+					  proc) < (int)sizeof(e->path))
+			break;
+		printf("\tProcess name %s%s is too long, skipped\n",
+			proc, too_long ? "..." : "");
+	}
+
+	e->proc = NULL;
+	return 0;
+}
+
+/* Everything but making the process visible, done before it starts.
+ * Return -1 when the program cannot be loaded */
+static int ld_prepare(struct ld_entry * e) {
+	/* Copies of a program share its parsed, decoded code */
+	struct pcb_t * proc = ld_image_get(e->path);
+	if (proc == NULL)
+		return -1;
+	proc->krnl = &os;
+
+#ifdef MLQ_SCHED
+	proc->prio = e->prio;
+#endif
+#ifdef MM_PAGING
+	/* Every process owns its page table, vma and symbol table */
+	proc->mm = malloc(sizeof(struct mm_struct));
+	init_mm(proc->mm, proc);
+#endif
+	e->proc = proc;
+	return 0;
+}
+
+/* A prepared process that will not run after all */
+static void ld_release(struct pcb_t * proc) {
+#ifdef MM_PAGING
+	free_pcb_memph(proc);
+	free_mm(proc->mm);
+	free(proc->mm);
+#endif
+	ld_image_put(proc);
+	free(proc);
+}
+
 static void * ld_routine(void * args) {
 #ifdef MM_PAGING
 	struct memphy_struct* mram = ((struct mmpaging_ld_args *)args)->mram;
 	struct memphy_struct** mswp = ((struct mmpaging_ld_args *)args)->mswp;
 	struct memphy_struct* active_mswp = ((struct mmpaging_ld_args *)args)->active_mswp;
-	struct timer_id_t * timer_id = ((struct mmpaging_ld_args *)args)->timer_id;
+	struct slot_event * timer_id = ((struct mmpaging_ld_args *)args)->timer_id;
 #else
-	struct timer_id_t * timer_id = (struct timer_id_t*)args;
+	struct slot_event * timer_id = (struct slot_event*)args;
 #endif
-	int i = 0;
+	struct ld_entry ahead[LD_AHEAD_MAX];
+	struct ld_entry next;
+	int have_next, head = 0, count = 0;
 	printf("ld_routine\n");
 	
 #ifdef MM_PAGING
-	/* Initialize kernel structure ONCE before loading processes */
-	os.mm = malloc(sizeof(struct mm_struct));
+	/* Initialize kernel structure ONCE before loading processes,
+	 * each process brings its own address space */
+	os.mm = NULL;
 	os.mram = mram;
 	os.mswp = mswp;
 	os.active_mswp = active_mswp;
 #endif
 
-	while (i < num_processes) {
-		struct pcb_t * proc = load(ld_processes.path[i]);
-		proc->krnl = &os;
+	have_next = ld_read_entry(&next) == 0;
+	while (have_next || count > 0) {
+		unsigned long now = slot_time();
+
+		/* Load what starts soon while the CPUs run */
+		while (have_next && count < LD_AHEAD_MAX &&
+		       next.start_time <= now + ld_ahead) {
+			struct ld_entry * e = &ahead[(head + count) % LD_AHEAD_MAX];
+
+			*e = next;
+			if (ld_prepare(e) == 0)
+				count++;
+			else
+				printf("\tCannot load %s, skipped\n", e->path);
+			have_next = ld_read_entry(&next) == 0;
+		}
 
-#ifdef MLQ_SCHED
-		proc->prio = ld_processes.prio[i];
-#endif
-		while (current_time() < ld_processes.start_time[i]) {
-			next_slot(timer_id);
+		if (count == 0) {
+			slot_next_until(timer_id, next.start_time > (unsigned long)ld_ahead ?
+					next.start_time - ld_ahead : 0);
+			continue;
 		}
-#ifdef MM_PAGING
-		/* Initialize mm for first process only */
-		if (i == 0) {
-			init_mm(os.mm, proc);
+		if (ahead[head].start_time > now) {
+			slot_next_until(timer_id, ahead[head].start_time);
+			continue;
 		}
-#endif
-		printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
-			ld_processes.path[i], proc->pid, ld_processes.prio[i]);
-		add_proc(proc);
-		free(ld_processes.path[i]);
-		i++;
-		next_slot(timer_id);
+
+		/* One process starts per slot */
+		struct pcb_t * proc = ahead[head].proc;
+
+		/* System calls find their caller through the PID index, a
+		 * process they would not find does not start */
+		if (pid_index_add(&os, proc) != 0) {
+			printf("\tCannot load %s, PID %d is not indexed\n",
+				ahead[head].path, proc->pid);
+			ld_release(proc);
+		} else {
+			printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
+				ahead[head].path, proc->pid, ahead[head].prio);
+			rq_add_proc(proc);
+		}
+		head = (head + 1) % LD_AHEAD_MAX;
+		count--;
+		slot_next(timer_id);
 	}
-	free(ld_processes.path);
-	free(ld_processes.start_time);
-	done = 1;
-	detach_event(timer_id);
+	/* Options of older configs, read too late to apply */
+	char key[64], val[64];
+	while (fscanf(ld_stream.file, "%63s %63s", key, val) == 2)
+		printf("Config option %s %s after the process list is ignored\n",
+			key, val);
+	fclose(ld_stream.file);
+	/* Programs are kept for reuse until now */
+	ld_image_flush();
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	slot_detach(timer_id);
 	pthread_exit(NULL);
 }
 
-static void read_config(const char * path) {
-	FILE * file;
-	if ((file = fopen(path, "r")) == NULL) {
-		printf("Cannot find configure file at %s\n", path);
-		exit(1);
+/* Optional "KEY value" lines may come between the header and the process
+ * list */
+static void config_option(const char * key, const char * val) {
+	if (strcmp(key, "SCHED") == 0) {
+		if (rq_select(val) != 0)
+			printf("Unknown config option %s %s\n", key, val);
+		return;
+	}
+	if (strcmp(key, "MIGRATION_COST") == 0) {
+		rq_set_migration_cost(atoi(val));
+		return;
+	}
+	if (strcmp(key, "TICKLESS") == 0) {
+		slot_set_tickless(atoi(val));
+		return;
+	}
+	if (strcmp(key, "CPU_WORKERS") == 0) {
+		cpu_workers = atoi(val);
+		return;
 	}
+	if (strcmp(key, "LOAD_AHEAD") == 0) {
+		ld_ahead = atoi(val) > 0 ? atoi(val) : 0;
+		return;
+	}
+#ifdef MM_PAGING
+	if (strcmp(key, "PGREPL") == 0) {
+		pgrepl_select(val);
+		return;
+	}
+	if (strcmp(key, "RECLAIM_LOW") == 0 || strcmp(key, "RECLAIM_HIGH") == 0) {
+		/* Checked against each other once both are read */
+		if (atoi(val) < 0)
+			printf("Invalid config option %s %s\n", key, val);
+		else if (strcmp(key, "RECLAIM_LOW") == 0)
+			reclaim_low = atoi(val);
+		else
+			reclaim_high = atoi(val);
+		return;
+	}
+#endif
+	printf("Unknown config option %s %s\n", key, val);
+}
+
+/* Lines before the process list and its options, NULL when there is no
+ * such file */
+static FILE * read_config_header(const char * path) {
+	FILE * file;
+	if ((file = fopen(path, "r")) == NULL)
+		return NULL;
 	fscanf(file, "%d %d %d\n", &time_slot, &num_cpus, &num_processes);
-	ld_processes.path = (char**)malloc(sizeof(char*) * num_processes);
-	ld_processes.start_time = (unsigned long*)
-		malloc(sizeof(unsigned long) * num_processes);
 #ifdef MM_PAGING
 	int sit;
 #ifdef MM_FIXED_MEMSZ
@@ -186,50 +465,94 @@ static void read_config(const char * path) {
 #endif
 #endif
 
-#ifdef MLQ_SCHED
-	ld_processes.prio = (unsigned long*)
-		malloc(sizeof(unsigned long) * num_processes);
-#endif
-	int i;
-	for (i = 0; i < num_processes; i++) {
-		ld_processes.path[i] = (char*)malloc(sizeof(char) * 100);
-		ld_processes.path[i][0] = '\0';
-		strcat(ld_processes.path[i], "input/proc/");
-		char proc[100];
-#ifdef MLQ_SCHED
-		fscanf(file, "%lu %s %lu\n", &ld_processes.start_time[i], proc, &ld_processes.prio[i]);
-#else
-		fscanf(file, "%lu %s\n", &ld_processes.start_time[i], proc);
-#endif
-		strcat(ld_processes.path[i], proc);
+	return file;
+}
+
+/* Option lines up to the first entry of the process list, which starts
+ * with a digit; the list is left unread */
+static void read_config_options(FILE * file, int apply) {
+	char key[64], val[64];
+	int c;
+
+	fscanf(file, " ");
+	while ((c = fgetc(file)) != EOF && !isdigit(c)) {
+		ungetc(c, file);
+		if (fscanf(file, "%63s %63s ", key, val) != 2)
+			return;
+		if (apply)
+			config_option(key, val);
 	}
+	if (c != EOF)
+		ungetc(c, file);
 }
 
-int main(int argc, char * argv[]) {
-	/* Read config */
-	if (argc != 2) {
-		printf("Usage: os [path to configure file]\n");
-		return 1;
+static void read_config(const char * path) {
+	FILE * file;
+	if ((file = read_config_header(path)) == NULL) {
+		printf("Cannot find configure file at %s\n", path);
+		exit(1);
 	}
+
+	/* The loader streams the process list from here */
+	read_config_options(file, 1);
+	ld_stream.file = file;
+	ld_stream.left = num_processes;
+}
+
+/* Programs of a batch config are parsed once for all the instances */
+static void preload_config(const char * cfg) {
+	struct ld_entry e;
+	char path[100];
+
+	snprintf(path, sizeof(path), "input/%s", cfg);
+	ld_stream.file = read_config_header(path);
+	if (ld_stream.file == NULL)
+		return;
+
+	read_config_options(ld_stream.file, 0);
+	ld_stream.left = num_processes;
+	while (ld_read_entry(&e) == 0)
+		ld_image_preload(e.path);
+	fclose(ld_stream.file);
+}
+
+/* One simulation of a config, in the calling process */
+static int simulate(const char * cfg) {
+	/* Read config */
 	char path[100];
 	path[0] = '\0';
 	strcat(path, "input/");
-	strcat(path, argv[1]);
+	strcat(path, cfg);
 	read_config(path);
 
-	pthread_t * cpu = (pthread_t*)malloc(num_cpus * sizeof(pthread_t));
+	/* A thread per simulated CPU, or a pool of worker threads */
+	if (cpu_workers < 0 || cpu_workers > num_cpus)
+		cpu_workers = 0;
+	int nthreads = cpu_workers > 0 ? cpu_workers : num_cpus;
+
+	pthread_t * cpu = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
 	struct cpu_args * args =
-		(struct cpu_args*)malloc(sizeof(struct cpu_args) * num_cpus);
+		(struct cpu_args*)calloc(num_cpus, sizeof(struct cpu_args));
+	struct slot_event ** worker_event =
+		(struct slot_event**)malloc(nthreads * sizeof(struct slot_event*));
 	pthread_t ld;
 	
 	/* Init timer */
 	int i;
-	for (i = 0; i < num_cpus; i++) {
-		args[i].timer_id = attach_event();
+	for (i = 0; i < num_cpus; i++)
 		args[i].id = i;
+	for (i = 0; i < nthreads; i++) {
+		worker_event[i] = slot_attach();
+		if (cpu_workers == 0)
+			args[i].timer_id = worker_event[i];
 	}
-	struct timer_id_t * ld_event = attach_event();
-	start_timer();
+	worker_cpu = args;
+	struct slot_event * ld_event = slot_attach();
+#ifdef MM_PAGING
+	pthread_t kswapd;
+	struct slot_event * kswapd_event = slot_attach();
+#endif
+	slot_start();
 
 #ifdef MM_PAGING
 	/* Init all MEMPHY include 1 MEMRAM and n of MEMSWP */
@@ -240,11 +563,14 @@ int main(int argc, char * argv[]) {
 
 	/* Create MEM RAM */
 	init_memphy(&mram, memramsz, rdmflag);
+	MEMPHY_init_frames(&mram, num_cpus);
 
         /* Create all MEM SWAP */ 
 	int sit;
-	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
+	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++) {
 	       init_memphy(&mswp[sit], memswpsz[sit], rdmflag);
+	       MEMPHY_init_frames(&mswp[sit], num_cpus);
+	}
 
 	/* In Paging mode, it needs passing the system mem to each PCB through loader*/
 	struct mmpaging_ld_args *mm_ld_args = malloc(sizeof(struct mmpaging_ld_args));
@@ -254,34 +580,103 @@ int main(int argc, char * argv[]) {
 	mm_ld_args->mswp = (struct memphy_struct**) &mswp;
 	mm_ld_args->active_mswp = (struct memphy_struct *) &mswp[0];
         mm_ld_args->active_mswp_id = 0;
+
+	/* Free frame watermarks of the reclaim daemon (default: derived
+	 * from the MEMRAM size, high twice low when only low is given) */
+	if (reclaim_high >= 0 && reclaim_low < 0)
+		printf("Invalid config option RECLAIM_HIGH %d without RECLAIM_LOW\n",
+			reclaim_high);
+	else if (reclaim_high >= 0 && reclaim_high < reclaim_low)
+		printf("Invalid config option RECLAIM_HIGH %d below RECLAIM_LOW %d\n",
+			reclaim_high, reclaim_low);
+	else if (reclaim_low >= 0)
+		mm_reclaim_set_watermark(reclaim_low,
+			reclaim_high >= 0 ? reclaim_high : 2 * reclaim_low);
+#endif
+
+#ifdef CPU_TLB
+	/* One set-associative TLB per simulated CPU, default geometry */
+	init_tlb(num_cpus, 0, 0);
 #endif
 
 	/* Init scheduler */
 	init_scheduler();
+	rq_init(num_cpus);
+	pid_index_init(&os);
 
 	/* Run CPU and loader */
 #ifdef MM_PAGING
 	pthread_create(&ld, NULL, ld_routine, (void*)mm_ld_args);
+	pthread_create(&kswapd, NULL, kswapd_routine, (void*)kswapd_event);
 #else
 	pthread_create(&ld, NULL, ld_routine, (void*)ld_event);
 #endif
-	for (i = 0; i < num_cpus; i++) {
-		pthread_create(&cpu[i], NULL,
-			cpu_routine, (void*)&args[i]);
+	for (i = 0; i < nthreads; i++) {
+		if (cpu_workers > 0)
+			pthread_create(&cpu[i], NULL,
+				worker_routine, (void*)worker_event[i]);
+		else
+			pthread_create(&cpu[i], NULL,
+				cpu_routine, (void*)&args[i]);
 	}
 
 	/* Wait for CPU and loader finishing */
-	for (i = 0; i < num_cpus; i++) {
+	for (i = 0; i < nthreads; i++) {
 		pthread_join(cpu[i], NULL);
 	}
 	pthread_join(ld, NULL);
+#ifdef MM_PAGING
+	pthread_join(kswapd, NULL);
+#endif
 
 	/* Stop timer */
-	stop_timer();
+	slot_stop();
+	free(worker_event);
+	free(cpu);
+
+	/* Migrations per CPU, next to the TLB misses they cause */
+	for (i = 0; i < num_cpus; i++) {
+		unsigned long dispatch, migrations;
+
+		rq_get_stats(i, &dispatch, &migrations);
+		printf("CPU %d: %lu dispatches, %lu migrations", i, dispatch, migrations);
+#ifdef CPU_TLB
+		unsigned long hit, miss;
+
+		tlb_get_stats(i, &hit, &miss);
+		printf(", TLB %lu hits, %lu misses", hit, miss);
+#endif
+		printf("\n");
+	}
+
+	rq_destroy();
+	pid_index_destroy(&os);
+	free(args);
+#ifdef MM_PAGING
+	free(mm_ld_args);
+#endif
 
 	return 0;
 
 }
 
+int main(int argc, char * argv[]) {
+	int jobs = 0, i;
 
+	/* os [-j jobs] config... runs a batch */
+	if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+		jobs = atoi(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc < 2) {
+		printf("Usage: os [-j jobs] [path to configure file]...\n");
+		return 1;
+	}
+	if (argc == 2 && jobs == 0)
+		return simulate(argv[1]);
 
+	for (i = 1; i < argc; i++)
+		preload_config(argv[i]);
+	return batch_run(argc - 1, argv + 1, jobs, simulate) > 0;
+}
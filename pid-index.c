@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * PID to PCB index
+ *
+ * The loader registers every process it creates and the CPU that sees a
+ * process finish takes it out, so a system call finds its caller in
+ * constant time whichever queue the process sits in. The table is split
+ * in chunks allocated on first use and never moved: lookups take no lock,
+ * only registrations are serialized. The directory of chunks doubles as
+ * PIDs grow; a lookup may still read the one it replaced, so every
+ * directory is kept until the index goes away.
+ */
+
+#include "common.h"
+#include "os-mm.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define PID_INDEX_CHUNK  256
+#define PID_INDEX_NCHUNK 256 /* first directory, PIDs below 65536 */
+
+struct pid_dir {
+	struct pid_dir * old;		/* the directory this one replaced */
+	uint32_t nchunk;
+	struct pcb_t ** chunk[];
+};
+
+struct pid_index {
+	pthread_mutex_t lock;
+	struct pid_dir * dir;
+};
+
+static struct pid_dir * pid_dir_alloc(uint32_t nchunk) {
+	struct pid_dir * dir = calloc(1, sizeof(struct pid_dir) +
+				      nchunk * sizeof(struct pcb_t **));
+
+	if (dir != NULL)
+		dir->nchunk = nchunk;
+	return dir;
+}
+
+/* Chunk of PID chunk c in the current directory, NULL if not there yet */
+static struct pcb_t ** pid_chunk(struct pid_index * idx, uint32_t c) {
+	struct pid_dir * dir = __atomic_load_n(&idx->dir, __ATOMIC_ACQUIRE);
+
+	if (c >= dir->nchunk)
+		return NULL;
+	return __atomic_load_n(&dir->chunk[c], __ATOMIC_ACQUIRE);
+}
+
+int pid_index_init(struct krnl_t * krnl) {
+	struct pid_index * idx = calloc(1, sizeof(struct pid_index));
+
+	if (idx == NULL)
+		return -1;
+
+	idx->dir = pid_dir_alloc(PID_INDEX_NCHUNK);
+	if (idx->dir == NULL) {
+		free(idx);
+		return -1;
+	}
+
+	pthread_mutex_init(&idx->lock, NULL);
+	krnl->pid_index = idx;
+	return 0;
+}
+
+void pid_index_destroy(struct krnl_t * krnl) {
+	struct pid_index * idx = krnl->pid_index;
+	struct pid_dir * dir;
+	uint32_t i;
+
+	if (idx == NULL)
+		return;
+
+	/* Chunks are shared by all the directories, the last one has them all */
+	for (i = 0; i < idx->dir->nchunk; i++)
+		free(idx->dir->chunk[i]);
+	while ((dir = idx->dir) != NULL) {
+		idx->dir = dir->old;
+		free(dir);
+	}
+	pthread_mutex_destroy(&idx->lock);
+	free(idx);
+	krnl->pid_index = NULL;
+}
+
+int pid_index_add(struct krnl_t * krnl, struct pcb_t * proc) {
+	struct pid_index * idx = krnl->pid_index;
+	uint32_t c = proc->pid / PID_INDEX_CHUNK;
+	struct pid_dir * dir;
+	struct pcb_t ** chunk;
+
+	if (idx == NULL)
+		return -1;
+
+	pthread_mutex_lock(&idx->lock);
+	dir = idx->dir;
+	if (c >= dir->nchunk) {
+		uint32_t n = dir->nchunk;
+		struct pid_dir * grown;
+
+		while (n <= c)
+			n *= 2;
+		grown = pid_dir_alloc(n);
+		if (grown == NULL) {
+			pthread_mutex_unlock(&idx->lock);
+			return -1;
+		}
+		memcpy(grown->chunk, dir->chunk, dir->nchunk * sizeof(struct pcb_t **));
+		grown->old = dir;
+		__atomic_store_n(&idx->dir, grown, __ATOMIC_RELEASE);
+		dir = grown;
+	}
+
+	chunk = dir->chunk[c];
+	if (chunk == NULL) {
+		chunk = calloc(PID_INDEX_CHUNK, sizeof(struct pcb_t *));
+		if (chunk == NULL) {
+			pthread_mutex_unlock(&idx->lock);
+			return -1;
+		}
+		/* Published zeroed, readers may see it right away */
+		__atomic_store_n(&dir->chunk[c], chunk, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&chunk[proc->pid % PID_INDEX_CHUNK], proc, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&idx->lock);
+
+	return 0;
+}
+
+void pid_index_del(struct krnl_t * krnl, struct pcb_t * proc) {
+	struct pid_index * idx = krnl->pid_index;
+	struct pcb_t ** chunk;
+
+	if (idx == NULL)
+		return;
+
+	chunk = pid_chunk(idx, proc->pid / PID_INDEX_CHUNK);
+	if (chunk != NULL)
+		__atomic_store_n(&chunk[proc->pid % PID_INDEX_CHUNK], NULL, __ATOMIC_RELEASE);
+}
+
+struct pcb_t * pid_index_get(struct krnl_t * krnl, uint32_t pid) {
+	struct pid_index * idx = krnl->pid_index;
+	struct pcb_t ** chunk;
+
+	if (idx == NULL)
+		return NULL;
+
+	chunk = pid_chunk(idx, pid / PID_INDEX_CHUNK);
+	if (chunk == NULL)
+		return NULL;
+
+	return __atomic_load_n(&chunk[pid % PID_INDEX_CHUNK], __ATOMIC_ACQUIRE);
+}
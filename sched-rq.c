@@ -0,0 +1,863 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * Per-CPU run queues
+ *
+ * Every CPU keeps its own ready queue, so dispatching does not serialize
+ * the CPUs on one scheduler lock. Processes handed over by another thread
+ * (the loader) are pushed on an inbox of the target CPU, a bounded
+ * lock-free MPMC queue moved into the run queue by whoever takes it: the
+ * owner on its next dispatch or a thief. When every inbox is full they
+ * spill to a locked list of the target, nobody ever waits for room. A
+ * CPU left without work steals half the queue of its busiest peer, and
+ * every RQ_BALANCE_INTERVAL dispatches it evens out the load with that
+ * peer.
+ *
+ * How a queue orders its processes is up to a policy, picked by name
+ * (SCHED option of the config file) before the queues are set up:
+ *   mlq  - one ring per priority level with MLQ slot budgets
+ *   fair - weighted virtual runtime order, the weight coming from prio
+ *
+ * mlq: a level is a ring with a single producer, the owning CPU, and any
+ * number of consumers: the owner and the CPUs stealing from it all take
+ * the oldest process with one compare-and-swap on the ring head. The
+ * levels are indexed by bitmaps, one bit per level: ready (the level may
+ * hold processes) and budget (the level has slots left), summarized one
+ * bit per 64 levels. Picking the next process is a find-first-set on the
+ * summary and one on a bitmap word, whatever MAX_PRIO is. Only the owner
+ * writes the bitmaps; a level emptied by a thief keeps its ready bit
+ * until the owner finds it empty.
+ *
+ * fair: runnable processes sit in a treap ordered by virtual runtime,
+ * under a lock of the CPU only a thief contends for. The process with
+ * the smallest virtual runtime runs next, for a slice that grows with its
+ * weight, and is charged the slice scaled down by its weight.
+ *
+ * Soft affinity: a preempted process goes back on the queue of the CPU
+ * it ran on. With a migration cost set (MIGRATION_COST option, in time
+ * slots) a process that ran less than that long ago is cache hot: its
+ * TLB entries and page walks are still warm on its CPU, so neither a
+ * thief nor the balancer takes it. A queued process cools down while it
+ * waits, no process stays pinned longer than the migration cost, and a
+ * CPU idle for that long takes a hot one rather than nothing.
+ */
+
+#include "common.h"
+#include "queue.h"
+#include "sched.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef MLQ_SCHED
+#define RQ_NPRIO MAX_PRIO
+#else
+#define RQ_NPRIO 1
+#endif
+
+#define RQ_NWORDS ((RQ_NPRIO + 63) / 64)
+#if RQ_NWORDS > 64
+#error "MAX_PRIO above 4096 does not fit the level summary"
+#endif
+
+#define RQ_RING_MIN 8
+#define RQ_INBOX_SIZE 256
+#define RQ_BALANCE_INTERVAL 8
+
+/* enqueue flags */
+#define RQ_ENQ_NEW      1	/* not run yet */
+#define RQ_ENQ_MIGRATED 2	/* taken from another CPU */
+
+#define FAIR_WEIGHT0    1024	/* weight of the middle priority */
+#define FAIR_SLICE_MAX  4	/* slice at most FAIR_SLICE_MAX time slots */
+
+struct rq_buf {
+	long mask;
+	struct rq_buf * old;		/* buffer it replaced, a thief may still read it */
+	struct pcb_t * slot[];
+};
+
+struct rq_ring {
+	long head;			/* oldest process, taken by CAS */
+	long tail;			/* next free slot, moved by the owner only */
+	struct rq_buf * buf;
+};
+
+struct rq {
+	/* mlq */
+	struct rq_ring level[RQ_NPRIO];
+	uint64_t ready[RQ_NWORDS];	/* level may hold processes, thieves read it */
+	uint64_t budget[RQ_NWORDS];	/* level has slots left */
+	uint64_t rsum;			/* ready word not zero */
+	uint64_t esum;			/* ready & budget word not zero */
+	uint16_t slot[RQ_NPRIO];	/* MLQ slots left */
+	/* fair */
+	pthread_mutex_t lock;
+	struct pcb_t * root;
+	uint64_t min_vruntime;
+	uint32_t seed;
+
+	struct mpmc_queue * inbox;
+	pthread_mutex_t spill_lock;	/* inbox overflow, linked by se.right */
+	struct pcb_t * spill_head;
+	struct pcb_t * spill_tail;
+	int nr;				/* queued processes, inbox included (atomic) */
+	int ticks;			/* dispatches since the last balance */
+	int idle;			/* found nothing to run since idle_since */
+	uint64_t idle_since;
+	unsigned long nr_dispatch;	/* processes dispatched */
+	unsigned long nr_migrations;	/* of which last ran on another CPU */
+} __attribute__((aligned(64)));
+
+struct rq_ops {
+	const char * name;
+	void (*init)(struct rq * rq);
+	void (*destroy)(struct rq * rq);
+	/* called by the CPU owning rq only */
+	int (*enqueue)(struct rq * rq, struct pcb_t * proc, int flags);
+	struct pcb_t * (*pick)(struct rq * rq);
+	/* called by any CPU, cold leaves cache hot processes where they are */
+	struct pcb_t * (*steal)(struct rq * rq, int cold);
+	int (*slice)(struct pcb_t * proc, int time_slot);
+};
+
+static struct rq * rqs = NULL;
+static int rq_ncpu = 0;
+static uint64_t rq_migration_cost = 0;	/* time slots, 0: no affinity */
+
+/* CPU whose run queue the calling thread owns, -1 if none */
+static __thread int rq_cpu = -1;
+
+static int rq_prio(struct pcb_t * proc) {
+#ifdef MLQ_SCHED
+	return proc->prio < RQ_NPRIO ? proc->prio : RQ_NPRIO - 1;
+#else
+	return 0;
+#endif
+}
+
+/* Ran on its CPU within the migration cost */
+static int rq_hot(struct pcb_t * proc) {
+	/* A process that never ran (se.cpu < 0) is cold on every CPU */
+	if (rq_migration_cost == 0 ||
+	    __atomic_load_n(&proc->se.cpu, __ATOMIC_RELAXED) < 0)
+		return 0;
+
+	return slot_time() -
+	       __atomic_load_n(&proc->se.last_ran, __ATOMIC_RELAXED) < rq_migration_cost;
+}
+
+/*
+ * mlq
+ */
+
+/* Recompute the summary bits of bitmap word w */
+static void rq_sync(struct rq * rq, int w) {
+	uint64_t bit = 1ULL << w;
+
+	if (rq->ready[w] != 0)
+		rq->rsum |= bit;
+	else
+		rq->rsum &= ~bit;
+
+	if (rq->ready[w] & rq->budget[w])
+		rq->esum |= bit;
+	else
+		rq->esum &= ~bit;
+}
+
+static void rq_set_ready(struct rq * rq, int prio, int ready) {
+	int w = prio / 64;
+	uint64_t bit = 1ULL << (prio % 64);
+	uint64_t word = rq->ready[w];
+
+	if (ready == !!(word & bit))
+		return;
+
+	__atomic_store_n(&rq->ready[w], ready ? word | bit : word & ~bit,
+			 __ATOMIC_RELAXED);
+	rq_sync(rq, w);
+}
+
+/* New round: every level gets MAX_PRIO - prio slots */
+static void rq_refill(struct rq * rq) {
+	int prio, w;
+
+	for (prio = 0; prio < RQ_NPRIO; prio++)
+		rq->slot[prio] = RQ_NPRIO - prio;
+
+	for (w = 0; w < RQ_NWORDS; w++) {
+		rq->budget[w] = ~0ULL;
+		if (w == RQ_NWORDS - 1 && RQ_NPRIO % 64 != 0)
+			rq->budget[w] = (1ULL << (RQ_NPRIO % 64)) - 1;
+		rq_sync(rq, w);
+	}
+}
+
+/* Owner only */
+static int ring_push(struct rq_ring * r, struct pcb_t * proc) {
+	long t = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+	long h = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	struct rq_buf * b = r->buf;
+
+	if (b == NULL || t - h > b->mask) {
+		long size = b == NULL ? RQ_RING_MIN : 2 * (b->mask + 1);
+		struct rq_buf * nb = malloc(sizeof(struct rq_buf) +
+					    size * sizeof(struct pcb_t *));
+		long i;
+
+		if (nb == NULL)
+			return -1;
+
+		/* Processes thieves take meanwhile are copied too, harmless
+		 * as they are below the head from now on */
+		nb->mask = size - 1;
+		nb->old = b;
+		for (i = h; i < t; i++)
+			nb->slot[i & nb->mask] =
+				__atomic_load_n(&b->slot[i & b->mask], __ATOMIC_RELAXED);
+		__atomic_store_n(&r->buf, nb, __ATOMIC_RELEASE);
+		b = nb;
+	}
+
+	__atomic_store_n(&b->slot[t & b->mask], proc, __ATOMIC_RELAXED);
+	__atomic_store_n(&r->tail, t + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* Any CPU. A thief passes cold: the oldest process, the coldest of the
+ * ring, is left in place when cache hot */
+static struct pcb_t * ring_pop(struct rq_ring * r, int cold) {
+	long h = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		long t = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+		struct rq_buf * b;
+		struct pcb_t * proc;
+
+		if (h >= t)
+			return NULL;
+
+		/* Read after the tail: the buffer holds at least [h, t) */
+		b = __atomic_load_n(&r->buf, __ATOMIC_ACQUIRE);
+		proc = __atomic_load_n(&b->slot[h & b->mask], __ATOMIC_RELAXED);
+		if (cold && rq_hot(proc))
+			return NULL;
+		if (__atomic_compare_exchange_n(&r->head, &h, h + 1, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return proc;
+	}
+}
+
+static int ring_empty(struct rq_ring * r) {
+	return __atomic_load_n(&r->head, __ATOMIC_RELAXED) >=
+	       __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+}
+
+/* A level out of slots still holds work, dropping the ready bits thieves
+ * left stale on the way */
+static int rq_starved(struct rq * rq) {
+	uint64_t sum;
+
+	for (sum = rq->rsum; sum != 0; sum &= sum - 1) {
+		int w = __builtin_ctzll(sum);
+		uint64_t word = rq->ready[w] & ~rq->budget[w];
+
+		for (; word != 0; word &= word - 1) {
+			int prio = w * 64 + __builtin_ctzll(word);
+
+			if (!ring_empty(&rq->level[prio]))
+				return 1;
+			rq_set_ready(rq, prio, 0);
+		}
+	}
+
+	return 0;
+}
+
+static void mlq_init(struct rq * rq) {
+	rq_refill(rq);
+}
+
+static void mlq_destroy(struct rq * rq) {
+	int prio;
+
+	for (prio = 0; prio < RQ_NPRIO; prio++) {
+		struct rq_buf * b = rq->level[prio].buf;
+
+		while (b != NULL) {
+			struct rq_buf * old = b->old;
+
+			free(b);
+			b = old;
+		}
+	}
+}
+
+static int mlq_enqueue(struct rq * rq, struct pcb_t * proc, int flags) {
+	int prio = rq_prio(proc);
+
+	if (ring_push(&rq->level[prio], proc) != 0)
+		return -1;
+
+	rq_set_ready(rq, prio, 1);
+	return 0;
+}
+
+static struct pcb_t * mlq_pick(struct rq * rq) {
+	int pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		while (rq->esum != 0) {
+			int w = __builtin_ctzll(rq->esum);
+			int prio = w * 64 + __builtin_ctzll(rq->ready[w] & rq->budget[w]);
+			struct pcb_t * proc = ring_pop(&rq->level[prio], 0);
+
+			if (proc == NULL) {
+				/* Emptied by thieves */
+				rq_set_ready(rq, prio, 0);
+				continue;
+			}
+
+			if (--rq->slot[prio] == 0) {
+				rq->budget[w] &= ~(1ULL << (prio % 64));
+				rq_sync(rq, w);
+			}
+			return proc;
+		}
+
+		/* Start a new round once the levels holding work have
+		 * used up their slots */
+		if (!rq_starved(rq))
+			break;
+		rq_refill(rq);
+	}
+
+	return NULL;
+}
+
+/* Highest priority first, the ready bits only cover levels that may
+ * hold work */
+static struct pcb_t * mlq_steal(struct rq * rq, int cold) {
+	int w;
+
+	for (w = 0; w < RQ_NWORDS; w++) {
+		uint64_t word = __atomic_load_n(&rq->ready[w], __ATOMIC_RELAXED);
+
+		for (; word != 0; word &= word - 1) {
+			struct pcb_t * proc =
+				ring_pop(&rq->level[w * 64 + __builtin_ctzll(word)], cold);
+
+			if (proc != NULL)
+				return proc;
+		}
+	}
+
+	return NULL;
+}
+
+static int mlq_slice(struct pcb_t * proc, int time_slot) {
+	return time_slot;
+}
+
+/*
+ * fair
+ */
+
+/* Weight per step of 1/40 of the priority range, each step is worth
+ * about 10% of CPU time against its neighbour */
+static const uint32_t fair_weights[40] = {
+	88761, 71755, 56483, 46273, 36291,
+	29154, 23254, 18705, 14949, 11916,
+	 9548,  7620,  6100,  4904,  3906,
+	 3121,  2501,  1991,  1586,  1277,
+	 1024,   820,   655,   526,   423,
+	  335,   272,   215,   172,   137,
+	  110,    87,    70,    56,    45,
+	   36,    29,    23,    18,    15,
+};
+
+static uint32_t fair_weight(struct pcb_t * proc) {
+	/* Without priorities every process weighs the same */
+	if (RQ_NPRIO == 1)
+		return FAIR_WEIGHT0;
+
+	return fair_weights[rq_prio(proc) * 40 / RQ_NPRIO];
+}
+
+/* Order by virtual runtime, the PID breaking ties */
+static int fair_before(struct pcb_t * a, struct pcb_t * b) {
+	if (a->se.vruntime != b->se.vruntime)
+		return a->se.vruntime < b->se.vruntime;
+	return a->pid < b->pid;
+}
+
+/* Split t into the processes ordered before n and the others */
+static void fair_split(struct pcb_t * t, struct pcb_t * n,
+		       struct pcb_t ** l, struct pcb_t ** r) {
+	if (t == NULL) {
+		*l = *r = NULL;
+	} else if (fair_before(t, n)) {
+		fair_split(t->se.right, n, &t->se.right, r);
+		*l = t;
+	} else {
+		fair_split(t->se.left, n, l, &t->se.left);
+		*r = t;
+	}
+}
+
+/* Every process of l is ordered before every process of r */
+static struct pcb_t * fair_merge(struct pcb_t * l, struct pcb_t * r) {
+	if (l == NULL)
+		return r;
+	if (r == NULL)
+		return l;
+
+	if (l->se.prio > r->se.prio) {
+		l->se.right = fair_merge(l->se.right, r);
+		return l;
+	}
+
+	r->se.left = fair_merge(l, r->se.left);
+	return r;
+}
+
+/* Unlink the leftmost process, its right subtree takes its place. A
+ * thief passes cold and only gets it when it is not cache hot */
+static struct pcb_t * fair_pop_first(struct pcb_t ** t, int cold) {
+	struct pcb_t * first;
+
+	if (*t == NULL)
+		return NULL;
+
+	while ((*t)->se.left != NULL)
+		t = &(*t)->se.left;
+
+	first = *t;
+	if (cold && rq_hot(first))
+		return NULL;
+	*t = first->se.right;
+	return first;
+}
+
+static void fair_init(struct rq * rq) {
+	pthread_mutex_init(&rq->lock, NULL);
+	rq->seed = 2463534242u;
+}
+
+static void fair_destroy(struct rq * rq) {
+	pthread_mutex_destroy(&rq->lock);
+}
+
+static int fair_enqueue(struct rq * rq, struct pcb_t * proc, int flags) {
+	struct pcb_t * l, * r;
+
+	pthread_mutex_lock(&rq->lock);
+
+	if (flags & RQ_ENQ_NEW) {
+		/* Start level with the processes already here */
+		proc->se.weight = fair_weight(proc);
+		proc->se.vruntime = rq->min_vruntime;
+	} else if (flags & RQ_ENQ_MIGRATED) {
+		/* Steal left it relative to the queue it came from */
+		proc->se.vruntime += rq->min_vruntime;
+	} else {
+		/* Back from a slice: charge it, scaled down by the weight */
+		proc->se.vruntime += (uint64_t)proc->se.slice *
+			FAIR_WEIGHT0 * FAIR_WEIGHT0 / proc->se.weight;
+	}
+
+	/* xorshift, the priorities only need to look random */
+	rq->seed ^= rq->seed << 13;
+	rq->seed ^= rq->seed >> 17;
+	rq->seed ^= rq->seed << 5;
+	proc->se.prio = rq->seed;
+	proc->se.left = proc->se.right = NULL;
+
+	fair_split(rq->root, proc, &l, &r);
+	rq->root = fair_merge(fair_merge(l, proc), r);
+
+	pthread_mutex_unlock(&rq->lock);
+	return 0;
+}
+
+static struct pcb_t * fair_pick(struct rq * rq) {
+	struct pcb_t * proc;
+
+	pthread_mutex_lock(&rq->lock);
+	proc = fair_pop_first(&rq->root, 0);
+	if (proc != NULL && proc->se.vruntime > rq->min_vruntime)
+		rq->min_vruntime = proc->se.vruntime;
+	pthread_mutex_unlock(&rq->lock);
+
+	return proc;
+}
+
+static struct pcb_t * fair_steal(struct rq * rq, int cold) {
+	struct pcb_t * proc;
+
+	pthread_mutex_lock(&rq->lock);
+	proc = fair_pop_first(&rq->root, cold);
+	if (proc != NULL)
+		proc->se.vruntime = proc->se.vruntime > rq->min_vruntime ?
+				    proc->se.vruntime - rq->min_vruntime : 0;
+	pthread_mutex_unlock(&rq->lock);
+
+	return proc;
+}
+
+/* Heavier processes run longer at a time, a slot at least */
+static int fair_slice(struct pcb_t * proc, int time_slot) {
+	uint64_t slice = (uint64_t)time_slot * proc->se.weight / FAIR_WEIGHT0;
+
+	if (slice < 1)
+		slice = 1;
+	if (slice > (uint64_t)FAIR_SLICE_MAX * time_slot)
+		slice = (uint64_t)FAIR_SLICE_MAX * time_slot;
+
+	proc->se.slice = slice;
+	return slice;
+}
+
+static const struct rq_ops rq_policies[] = {
+	{ "mlq",  mlq_init,  mlq_destroy,  mlq_enqueue,  mlq_pick,  mlq_steal,  mlq_slice },
+	{ "fair", fair_init, fair_destroy, fair_enqueue, fair_pick, fair_steal, fair_slice },
+};
+
+#define RQ_NPOLICY (sizeof(rq_policies) / sizeof(rq_policies[0]))
+
+static const struct rq_ops * rq_policy = &rq_policies[0];
+
+/*
+ * Policy independent part
+ */
+
+static int inbox_push(struct rq * rq, struct pcb_t * proc) {
+	/* Counted first, a thief must not see nr drop below zero */
+	__atomic_add_fetch(&rq->nr, 1, __ATOMIC_RELAXED);
+	if (mpmc_push(rq->inbox, proc) == 0)
+		return 0;
+
+	__atomic_sub_fetch(&rq->nr, 1, __ATOMIC_RELAXED);
+	return -1;
+}
+
+/* Hand proc over to the inbox of rq, or of any CPU when that one is full.
+ * When every inbox is full it spills to rq: the caller may be the loader
+ * or a CPU, both hold up the slot clock and cannot wait for the CPUs to
+ * drain anything. The flags go along for the enqueue at the other end */
+static void inbox_put(struct rq * rq, struct pcb_t * proc, int flags) {
+	int c = rq - rqs;
+	int i;
+
+	proc->se.enq_flags = flags;
+
+	for (i = 0; i < rq_ncpu; i++)
+		if (inbox_push(&rqs[(c + i) % rq_ncpu], proc) == 0)
+			return;
+
+	proc->se.right = NULL;
+	pthread_mutex_lock(&rq->spill_lock);
+	if (rq->spill_tail != NULL)
+		rq->spill_tail->se.right = proc;
+	else
+		__atomic_store_n(&rq->spill_head, proc, __ATOMIC_RELAXED);
+	rq->spill_tail = proc;
+	__atomic_add_fetch(&rq->nr, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&rq->spill_lock);
+}
+
+/* Queue proc on me, the queue of the calling CPU */
+static void local_push(struct rq * me, struct pcb_t * proc, int flags) {
+	if (rq_policy->enqueue(me, proc, flags) != 0) {
+		inbox_put(me, proc, flags);
+		return;
+	}
+	__atomic_add_fetch(&me->nr, 1, __ATOMIC_RELAXED);
+}
+
+static void inbox_enqueue(struct rq * me, struct rq * from, struct pcb_t * proc) {
+	__atomic_sub_fetch(&from->nr, 1, __ATOMIC_RELAXED);
+	if (rq_policy->enqueue(me, proc, proc->se.enq_flags) == 0)
+		__atomic_add_fetch(&me->nr, 1, __ATOMIC_RELAXED);
+	else
+		inbox_put(me, proc, proc->se.enq_flags);
+}
+
+/* Move the inbox of from onto me, oldest first, then what spilled over.
+ * Bounded by the inbox size and the spill taken at once, a process put
+ * back when out of memory is not seen again */
+static int inbox_take(struct rq * me, struct rq * from) {
+	struct pcb_t * proc, * spill;
+	int n = 0;
+
+	while (n < RQ_INBOX_SIZE && (proc = mpmc_pop(from->inbox)) != NULL) {
+		inbox_enqueue(me, from, proc);
+		n++;
+	}
+
+	if (__atomic_load_n(&from->spill_head, __ATOMIC_RELAXED) == NULL)
+		return n;
+
+	pthread_mutex_lock(&from->spill_lock);
+	spill = from->spill_head;
+	from->spill_head = from->spill_tail = NULL;
+	pthread_mutex_unlock(&from->spill_lock);
+
+	while ((proc = spill) != NULL) {
+		spill = proc->se.right;
+		inbox_enqueue(me, from, proc);
+		n++;
+	}
+
+	return n;
+}
+
+/* Move up to want processes of from to me, the most urgent first, only
+ * cache cold ones if cold */
+static int rq_pull(struct rq * me, struct rq * from, int want, int cold) {
+	int n = inbox_take(me, from);
+	struct pcb_t * proc;
+
+	while (n < want) {
+		proc = rq_policy->steal(from, cold);
+		if (proc == NULL)
+			break;
+		__atomic_sub_fetch(&from->nr, 1, __ATOMIC_RELAXED);
+		local_push(me, proc, RQ_ENQ_MIGRATED);
+		n++;
+	}
+
+	return n;
+}
+
+static struct rq * rq_busiest(struct rq * me, int * nr) {
+	struct rq * busiest = NULL;
+	int c;
+
+	*nr = 0;
+	for (c = 0; c < rq_ncpu; c++) {
+		int n = __atomic_load_n(&rqs[c].nr, __ATOMIC_RELAXED);
+
+		if (&rqs[c] != me && n > *nr) {
+			*nr = n;
+			busiest = &rqs[c];
+		}
+	}
+
+	return busiest;
+}
+
+static struct pcb_t * rq_pick(struct rq * me) {
+	struct pcb_t * proc;
+
+	if (__atomic_load_n(&me->nr, __ATOMIC_RELAXED) == 0)
+		return NULL;
+
+	proc = rq_policy->pick(me);
+	if (proc == NULL)
+		return NULL;
+
+	__atomic_sub_fetch(&me->nr, 1, __ATOMIC_RELAXED);
+	me->nr_dispatch++;
+	if (proc->se.cpu >= 0 && proc->se.cpu != rq_cpu) {
+		me->nr_migrations++;
+		proc->se.nr_migrations++;
+	}
+	__atomic_store_n(&proc->se.cpu, rq_cpu, __ATOMIC_RELAXED);
+
+	return proc;
+}
+
+/*
+ * rq_select - choose the policy of the run queues set up next
+ * @name : mlq or fair
+ */
+int rq_select(const char * name) {
+	unsigned long i;
+
+	for (i = 0; i < RQ_NPOLICY; i++) {
+		if (strcmp(rq_policies[i].name, name) == 0) {
+			rq_policy = &rq_policies[i];
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * rq_set_migration_cost - turn soft affinity on or off
+ * @slots : time slots a process stays cache hot after running, 0: off
+ */
+void rq_set_migration_cost(int slots) {
+	rq_migration_cost = slots > 0 ? slots : 0;
+}
+
+int rq_init(int ncpu) {
+	int c;
+
+	if (ncpu <= 0)
+		return -1;
+
+	/* One cache line per queue at least, CPUs do not share them */
+	if (posix_memalign((void **)&rqs, 64, ncpu * sizeof(struct rq)) != 0)
+		return -1;
+
+	memset(rqs, 0, ncpu * sizeof(struct rq));
+	for (c = 0; c < ncpu; c++) {
+		rqs[c].inbox = mpmc_create(RQ_INBOX_SIZE);
+		if (rqs[c].inbox == NULL) {
+			while (--c >= 0) {
+				mpmc_destroy(rqs[c].inbox);
+				rq_policy->destroy(&rqs[c]);
+			}
+			free(rqs);
+			rqs = NULL;
+			return -1;
+		}
+		pthread_mutex_init(&rqs[c].spill_lock, NULL);
+		rq_policy->init(&rqs[c]);
+	}
+	rq_ncpu = ncpu;
+
+	return 0;
+}
+
+void rq_destroy(void) {
+	int c;
+
+	for (c = 0; c < rq_ncpu; c++) {
+		mpmc_destroy(rqs[c].inbox);
+		pthread_mutex_destroy(&rqs[c].spill_lock);
+		rq_policy->destroy(&rqs[c]);
+	}
+
+	free(rqs);
+	rqs = NULL;
+	rq_ncpu = 0;
+}
+
+void rq_bind_cpu(int id) {
+	rq_cpu = id >= 0 && id < rq_ncpu ? id : -1;
+}
+
+/* A new process goes to the least loaded CPU */
+void rq_add_proc(struct pcb_t * proc) {
+	struct rq * target = &rqs[0];
+	int c;
+
+	proc->se.cpu = -1;
+	proc->se.last_ran = 0;
+	proc->se.nr_migrations = 0;
+
+	for (c = 1; c < rq_ncpu; c++)
+		if (__atomic_load_n(&rqs[c].nr, __ATOMIC_RELAXED) <
+		    __atomic_load_n(&target->nr, __ATOMIC_RELAXED))
+			target = &rqs[c];
+
+	inbox_put(target, proc, RQ_ENQ_NEW);
+}
+
+void rq_put_proc(struct pcb_t * proc) {
+	__atomic_store_n(&proc->se.last_ran, slot_time(), __ATOMIC_RELAXED);
+
+	if (rq_cpu < 0) {
+		inbox_put(&rqs[0], proc, 0);
+		return;
+	}
+
+	local_push(&rqs[rq_cpu], proc, 0);
+}
+
+struct pcb_t * rq_get_proc(void) {
+	struct rq * me, * busiest;
+	struct pcb_t * proc;
+	int nr;
+
+	/* Only the owner enqueues on its queue */
+	if (rq_cpu < 0)
+		return NULL;
+
+	me = &rqs[rq_cpu];
+	inbox_take(me, me);
+
+	if (++me->ticks >= RQ_BALANCE_INTERVAL) {
+		int mine = __atomic_load_n(&me->nr, __ATOMIC_RELAXED);
+
+		me->ticks = 0;
+		busiest = rq_busiest(me, &nr);
+		if (busiest != NULL && nr - mine >= 2)
+			rq_pull(me, busiest, (nr - mine) / 2, 1);
+	}
+
+	proc = rq_pick(me);
+	if (proc != NULL) {
+		me->idle = 0;
+		return proc;
+	}
+
+	/* Nothing left here, steal half of the busiest queue */
+	busiest = rq_busiest(me, &nr);
+	if (busiest != NULL && rq_pull(me, busiest, (nr + 1) / 2, 1) > 0)
+		proc = rq_pick(me);
+
+	/* Idle as long as a process stays hot, while its owner keeps it hot
+	 * by running the others: better run it here than not at all */
+	if (proc == NULL && busiest != NULL && me->idle &&
+	    slot_time() - me->idle_since >= rq_migration_cost &&
+	    rq_pull(me, busiest, 1, 0) > 0)
+		proc = rq_pick(me);
+
+	if (proc != NULL) {
+		me->idle = 0;
+	} else if (!me->idle) {
+		me->idle = 1;
+		me->idle_since = slot_time();
+	}
+	return proc;
+}
+
+/* Processes waiting on any CPU, inboxes included, running ones not */
+int rq_nr_queued(void) {
+	int c, nr = 0;
+
+	for (c = 0; c < rq_ncpu; c++)
+		nr += __atomic_load_n(&rqs[c].nr, __ATOMIC_RELAXED);
+
+	return nr;
+}
+
+/*
+ * rq_slice - time slots a process runs for once dispatched
+ * @proc      : process just returned by rq_get_proc()
+ * @time_slot : time slot of the config file
+ */
+int rq_slice(struct pcb_t * proc, int time_slot) {
+	return rq_policy->slice(proc, time_slot);
+}
+
+/*
+ * rq_get_stats - collect the dispatch counters of a CPU
+ * @cpuid      : CPU index
+ * @dispatch   : processes dispatched
+ * @migrations : of which last ran on another CPU
+ */
+int rq_get_stats(int cpuid, unsigned long * dispatch, unsigned long * migrations) {
+	if (cpuid < 0 || cpuid >= rq_ncpu)
+		return -1;
+
+	*dispatch = rqs[cpuid].nr_dispatch;
+	*migrations = rqs[cpuid].nr_migrations;
+
+	return 0;
+}
@@ -22,54 +22,42 @@
 
 //typedef char BYTE;
 
-int __sys_memmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
+#ifdef MM64
+/* Move every (phyaddr, len) segment of a vectored IO in one go */
+static int memmap_iov(struct pcb_t *caller, int memop,
+                      struct memmap_iovec *iov, arg_t niov)
 {
-   int memop = regs->a1;
-   BYTE value;
-   
-   /* TODO THIS DUMMY CREATE EMPTY PROC TO AVOID COMPILER NOTIFY 
-    *      need to be eliminated
-	*/
-   struct pcb_t *caller = NULL;
-   int i;
+   arg_t i;
 
-   /* Traverse running list to find the caller process */
-   if (krnl->running_list != NULL && krnl->running_list->size > 0) {
-       for (i = 0; i < krnl->running_list->size; i++) {
-           if (krnl->running_list->proc[i] != NULL && 
-               krnl->running_list->proc[i]->pid == pid) {
-               caller = krnl->running_list->proc[i];
-               break;
-           }
-       }
-   }
+   if (iov == NULL)
+       return -1;
 
-   /* If not found in running list, try MLQ ready queues */
-   #ifdef MLQ_SCHED
-   if (caller == NULL && krnl->mlq_ready_queue != NULL) {
-       int prio;
-       for (prio = 0; prio < MAX_PRIO && caller == NULL; prio++) {
-           for (i = 0; i < krnl->mlq_ready_queue[prio].size; i++) {
-               if (krnl->mlq_ready_queue[prio].proc[i] != NULL &&
-                   krnl->mlq_ready_queue[prio].proc[i]->pid == pid) {
-                   caller = krnl->mlq_ready_queue[prio].proc[i];
-                   break;
-               }
-           }
-       }
-   }
-   #endif
+   for (i = 0; i < niov; i++) {
+       int ret;
 
-   /* If still not found, try ready queue */
-   if (caller == NULL && krnl->ready_queue != NULL && krnl->ready_queue->size > 0) {
-       for (i = 0; i < krnl->ready_queue->size; i++) {
-           if (krnl->ready_queue->proc[i] != NULL &&
-               krnl->ready_queue->proc[i]->pid == pid) {
-               caller = krnl->ready_queue->proc[i];
-               break;
-           }
-       }
+       if (memop == SYSMEM_IO_READV)
+           ret = MEMPHY_read_buf(caller->krnl->mram, iov[i].phyaddr,
+                                 iov[i].buf, iov[i].len);
+       else
+           ret = MEMPHY_write_buf(caller->krnl->mram, iov[i].phyaddr,
+                                  iov[i].buf, iov[i].len);
+       if (ret != 0)
+           return -1;
    }
+
+   return 0;
+}
+#endif
+
+int __sys_memmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
+{
+   int memop = regs->a1;
+   BYTE value;
+   int ret = 0;
+   
+   /* The loader indexes every process by PID, whichever queue the
+    * caller sits in it is found without a scan */
+   struct pcb_t *caller = pid_index_get(krnl, pid);
    
    if (caller == NULL) {
        return -1; /* Process not found */
@@ -98,12 +86,20 @@ int __sys_memmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
    case SYSMEM_IO_WRITE:
             MEMPHY_write(caller->krnl->mram, regs->a2, regs->a3);
             break;
+#ifdef MM64
+   case SYSMEM_IO_READV:
+   case SYSMEM_IO_WRITEV:
+            /* a2: segment list, a3: number of segments */
+            ret = memmap_iov(caller, memop,
+                             (struct memmap_iovec *)(uintptr_t)regs->a2, regs->a3);
+            break;
+#endif
    default:
             printf("Memop code: %d\n", memop);
             break;
    }
    
-   return 0;
+   return ret;
 }
 
 
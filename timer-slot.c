@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+/*
+ * Slot clock
+ *
+ * Every thread of the simulation (CPUs, loader, reclaim daemon) attaches
+ * an event and ends each of its time slots with slot_next(). The last
+ * event to arrive moves the time on and releases the others, so all of
+ * them see the same slot.
+ *
+ * An event may also tell how long it has nothing to do: slot_next_until()
+ * waits for a known time, slot_next_idle() waits for whatever comes next.
+ * In tickless mode (TICKLESS option of the config file) the time then
+ * jumps straight to the earliest slot an event asked for, instead of
+ * going through every slot in between one at a time. A slot in which any
+ * event used slot_next() is always followed by the next one.
+ *
+ * The slot boundary is a combining tree barrier with sense reversal. The
+ * events are split in groups of SLOT_FANIN under a tree node, and so are
+ * the nodes of each level under the next one. An arrival only touches
+ * the counter of its group; the last one of a group arrives at the parent
+ * node, carrying the earliest wake up time of the group, and the last
+ * arrival at the root moves the time on and flips the global sense. The
+ * waiting events spin on the sense for a while, then sleep until the
+ * releaser wakes them all at once. A detached event leaves its group for
+ * good, and a group left empty leaves its parent.
+ */
+
+#include "timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define SLOT_IDLE  UINT64_MAX
+#define SLOT_FANIN 4
+#define SLOT_SPIN  1000		/* sense polls before sleeping */
+
+/* Group of SLOT_FANIN events or nodes */
+struct slot_node {
+	uint64_t count;		/* children expected << 32 | children arrived */
+	uint64_t wake;		/* earliest time asked for in the group, this slot */
+	struct slot_node * parent;
+} __attribute__((aligned(64)));
+
+struct slot_event {
+	struct slot_event * next;
+	struct slot_node * node;
+	int id;
+	int sense;		/* sense of the slot it waits for */
+	int detached;
+};
+
+static struct slot_event * slot_events = NULL;
+static int slot_nr_events = 0;
+static struct slot_node * slot_nodes = NULL;
+
+static int slot_sense = 0;
+static int slot_nr_sleeping = 0;
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t slot_cond = PTHREAD_COND_INITIALIZER;
+
+static uint64_t slot_now = 0;
+static int slot_started = 0;
+static int slot_tickless = 0;
+
+static void slot_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/* Last arrival of a slot: move the time on and release the events */
+static void slot_advance(uint64_t wake) {
+	uint64_t next = slot_now + 1;
+
+	if (slot_tickless && wake != SLOT_IDLE && wake > next)
+		next = wake;
+
+	__atomic_store_n(&slot_now, next, __ATOMIC_RELEASE);
+	printf("Time slot %3lu\n", (unsigned long)next);
+
+	/* Sleepers count themselves before checking the sense, either they
+	 * see the new sense or they are counted here */
+	__atomic_xor_fetch(&slot_sense, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&slot_nr_sleeping, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&slot_lock);
+		pthread_cond_broadcast(&slot_cond);
+		pthread_mutex_unlock(&slot_lock);
+	}
+}
+
+static void slot_min(uint64_t * wake, uint64_t t) {
+	uint64_t cur = __atomic_load_n(wake, __ATOMIC_RELAXED);
+
+	while (t < cur && !__atomic_compare_exchange_n(wake, &cur, t, 1,
+						       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/* One child of node is done with the slot */
+static void slot_arrive(struct slot_node * node, uint64_t wake) {
+	while (node != NULL) {
+		uint64_t c, nc;
+		int last;
+
+		slot_min(&node->wake, wake);
+
+		c = __atomic_load_n(&node->count, __ATOMIC_RELAXED);
+		do {
+			last = (c & 0xffffffffULL) + 1 == c >> 32;
+			nc = last ? c & ~0xffffffffULL : c + 1;
+		} while (!__atomic_compare_exchange_n(&node->count, &c, nc, 1,
+						      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+		if (!last)
+			return;
+
+		/* Nobody arrives again before the release */
+		wake = __atomic_exchange_n(&node->wake, SLOT_IDLE, __ATOMIC_ACQ_REL);
+		if (node->parent == NULL)
+			slot_advance(wake);
+		node = node->parent;
+	}
+}
+
+/* One child of node is gone for good */
+static void slot_leave(struct slot_node * node) {
+	while (node != NULL) {
+		uint64_t c, nc, expected, arrived;
+
+		c = __atomic_load_n(&node->count, __ATOMIC_RELAXED);
+		do {
+			expected = (c >> 32) - 1;
+			arrived = c & 0xffffffffULL;
+			/* The others may all be waiting for this one */
+			nc = expected << 32 | (arrived == expected ? 0 : arrived);
+		} while (!__atomic_compare_exchange_n(&node->count, &c, nc, 1,
+						      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+		if (arrived > 0 && arrived == expected) {
+			uint64_t wake = __atomic_exchange_n(&node->wake, SLOT_IDLE,
+							    __ATOMIC_ACQ_REL);
+
+			if (node->parent == NULL)
+				slot_advance(wake);
+			else
+				slot_arrive(node->parent, wake);
+			return;
+		}
+
+		/* An empty group leaves its parent */
+		if (expected > 0)
+			return;
+		node = node->parent;
+	}
+}
+
+static void slot_wait(struct slot_event * ev, uint64_t wake) {
+	int i;
+
+	ev->sense = !ev->sense;
+	slot_arrive(ev->node, wake);
+
+	for (i = 0; i < SLOT_SPIN; i++) {
+		if (__atomic_load_n(&slot_sense, __ATOMIC_ACQUIRE) == ev->sense)
+			return;
+		slot_relax();
+	}
+
+	pthread_mutex_lock(&slot_lock);
+	__atomic_add_fetch(&slot_nr_sleeping, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&slot_sense, __ATOMIC_SEQ_CST) != ev->sense)
+		pthread_cond_wait(&slot_cond, &slot_lock);
+	__atomic_sub_fetch(&slot_nr_sleeping, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&slot_lock);
+}
+
+/*
+ * slot_set_tickless - let the time jump over slots nobody needs
+ * @on : 0 to go through every slot
+ */
+void slot_set_tickless(int on) {
+	slot_tickless = on;
+}
+
+/* Events are attached before the clock starts */
+struct slot_event * slot_attach(void) {
+	struct slot_event * ev;
+
+	if (slot_started)
+		return NULL;
+
+	ev = calloc(1, sizeof(struct slot_event));
+	if (ev == NULL)
+		return NULL;
+
+	ev->id = slot_nr_events++;
+	ev->next = slot_events;
+	slot_events = ev;
+
+	return ev;
+}
+
+/* The event takes no part in the following slots */
+void slot_detach(struct slot_event * ev) {
+	if (ev->detached)
+		return;
+
+	ev->detached = 1;
+	slot_leave(ev->node);
+}
+
+/* Lay the tree over the attached events, level by level from the
+ * leaves, each node of a level under node index / SLOT_FANIN of the next */
+void slot_start(void) {
+	struct slot_event * ev;
+	int nr_nodes = 0, width, base, i;
+
+	for (width = slot_nr_events; width > 1 || nr_nodes == 0; ) {
+		width = (width + SLOT_FANIN - 1) / SLOT_FANIN;
+		nr_nodes += width;
+		if (slot_nr_events == 0)
+			break;
+	}
+
+	if (posix_memalign((void **)&slot_nodes, 64,
+			   nr_nodes * sizeof(struct slot_node)) != 0) {
+		printf("Cannot allocate the slot clock\n");
+		exit(1);
+	}
+
+	/* Children per node, the last node of a level may get less */
+	base = 0;
+	for (width = slot_nr_events; ; ) {
+		int up = (width + SLOT_FANIN - 1) / SLOT_FANIN;
+
+		for (i = 0; i < up; i++) {
+			struct slot_node * node = &slot_nodes[base + i];
+			uint64_t children = width - i * SLOT_FANIN;
+
+			if (children > SLOT_FANIN)
+				children = SLOT_FANIN;
+			node->count = children << 32;
+			node->wake = SLOT_IDLE;
+			node->parent = up > 1 ? &slot_nodes[base + up + i / SLOT_FANIN] : NULL;
+		}
+		if (up <= 1)
+			break;
+		base += up;
+		width = up;
+	}
+
+	for (ev = slot_events; ev != NULL; ev = ev->next)
+		ev->node = &slot_nodes[ev->id / SLOT_FANIN];
+
+	slot_started = 1;
+	printf("Time slot %3lu\n", (unsigned long)slot_time());
+}
+
+/* Every event is detached by now */
+void slot_stop(void) {
+	while (slot_events != NULL) {
+		struct slot_event * ev = slot_events;
+
+		slot_events = ev->next;
+		free(ev);
+	}
+	free(slot_nodes);
+	slot_nodes = NULL;
+	slot_nr_events = 0;
+	slot_started = 0;
+	/* New events start from sense 0 */
+	slot_sense = 0;
+	slot_now = 0;
+}
+
+uint64_t slot_time(void) {
+	return __atomic_load_n(&slot_now, __ATOMIC_ACQUIRE);
+}
+
+/* Done with the current slot, run again in the next one */
+void slot_next(struct slot_event * ev) {
+	slot_wait(ev, slot_time() + 1);
+}
+
+/* Nothing to do before time t */
+void slot_next_until(struct slot_event * ev, uint64_t t) {
+	uint64_t next = slot_time() + 1;
+
+	slot_wait(ev, t > next ? t : next);
+}
+
+/* Nothing to do until another event has work */
+void slot_next_idle(struct slot_event * ev) {
+	slot_wait(ev, SLOT_IDLE);
+}